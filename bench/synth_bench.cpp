@@ -0,0 +1,483 @@
+// End-to-end benchmark of both engines on a generated project: N sources over M
+// headers, each source including a few of them, the headers themselves layered D
+// deep. The sources are split across static Libraries linked into one Binary, next
+// to a few Commands. The same project goes out twice — as build.c on build.h and as
+// build.cpp on build.hpp — and each is timed on a cold build, a no-op build, a change
+// to one source and a change to the header every source ends up including.
+//
+//     g++ -std=c++23 -O2 -pthread bench/synth_bench.cpp -o synth_bench
+//     ./synth_bench [--sources 200] [--headers 60] [--fan-in 6] [--depth 4]
+//                   [--libraries 4] [--commands 2] [--seed 1] [-j N] [--runs 3]
+//                   [--engine both|c|cpp] [--dir /tmp/synth_bench] [--out synth_bench.json]
+//                   [--cc cc] [--cxx c++] [--script-cc "cc -std=c23 -pthread"]
+//                   [--script-cxx "c++ -std=c++23 -pthread"] [--repo .] [--generate-only]
+//
+// Run it from the repo root, or point --repo at it: the generated scripts include the
+// engine headers from the tree being measured, not a copy. The scripts are compiled
+// here, up front, so no run pays for (or times) a selfRebuild. Alongside the times,
+// every run records how many objects it actually recompiled — an engine that gets
+// faster by missing a rebuild shows up there, not as a win.
+
+#include "../build.hpp"
+
+#include <numeric>
+#include <random>
+
+struct Shape {
+        usize sources   = 200;
+        usize headers   = 60;
+        usize fan_in    = 6;
+        usize depth     = 4;
+        usize libraries = 4;
+        usize commands  = 2;
+        u32   seed      = 1;
+};
+
+struct Options {
+        Shape                 shape;
+        i32                   jobs          = static_cast<i32>(std::max(1u, std::thread::hardware_concurrency()));
+        usize                 runs          = 3;
+        std::string           engine        = "both";
+        std::filesystem::path dir           = std::filesystem::temp_directory_path() / "synth_bench";
+        std::filesystem::path out           = "synth_bench.json";
+        std::filesystem::path repo          = ".";
+        std::string           cc            = "cc";
+        std::string           cxx           = "c++";
+        std::string           script_cc     = "cc -std=c23 -pthread";
+        std::string           script_cxx    = "c++ -std=c++23 -pthread";
+        bool                  generate_only = false;
+};
+
+// One generated tree. common.h is the header every source ends up including: the
+// deepest layer includes it, and every other layer includes headers from the one
+// below.
+struct Project {
+        std::string           engine;
+        std::filesystem::path root;
+        std::string           script;
+        std::filesystem::path leaf;
+        std::filesystem::path hot_header;
+};
+
+struct Scenario {
+        std::string        name;
+        std::vector<f64>   seconds;
+        std::vector<usize> rebuilt;
+};
+
+static void writeFile(const std::filesystem::path& path, const std::string& contents) {
+    std::filesystem::create_directories(path.parent_path());
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file << contents;
+    if (!file) {
+        RLOG(LL_FATAL, "Failed to write " + path.string());
+    }
+}
+
+// Header h's layer: 0 is included straight from sources, depth - 1 includes only
+// common.h. Header 0 is common.h itself.
+static usize layerOf(const Shape& shape, usize header) { return (header - 1) * shape.depth / (shape.headers - 1); }
+
+static std::string headerName(usize header) { return header == 0 ? "common" : "h" + std::to_string(header); }
+
+// Both scripts split the sources into libraries the same way, in a loop rather than
+// a line per source — at a few thousand sources, compiling the script would
+// otherwise start to show up in the numbers.
+static std::string cScript(const Options& options) {
+    const Shape& shape = options.shape;
+    std::string  n     = std::to_string(shape.sources);
+    std::string  l     = std::to_string(shape.libraries);
+
+    return "#include \"" + (options.repo / "build.h").string() + "\"\n"
+           "\n"
+           "int main(int argc, char** argv) {\n"
+           "    Build build = newBuildWithCompiler(\".build\", \"" + options.cc + "\", argc, argv);\n"
+           "    char  path[64];\n"
+           "\n"
+           "    for (int library = 0; library < " + l + "; library++) {\n"
+           "        if (library > 0) {\n"
+           "            buildStep(&build);\n"
+           "        } else {\n"
+           "            for (int command = 0; command < " + std::to_string(shape.commands) + "; command++) {\n"
+           "                snprintf(path, sizeof(path), \"stamp%d\", command);\n"
+           "                buildAddPrebuildCommand(&build, newCommand(\"touch\", strdup(path)));\n"
+           "            }\n"
+           "        }\n"
+           "        buildAddInclude(&build, newDirectInclude(\"include\"));\n"
+           "        buildAddCompilationFlag(&build, \"-O1\");\n"
+           "        for (int source = library * " + n + " / " + l + "; source < (library + 1) * " + n + " / " + l + "; source++) {\n"
+           "            snprintf(path, sizeof(path), \"src/s%d.c\", source);\n"
+           "            buildAddObject(&build, newObject(path));\n"
+           "        }\n"
+           "        snprintf(path, sizeof(path), \"libsynth%d.a\", library);\n"
+           "        buildStepSetOutput(&build, strdup(path));\n"
+           "    }\n"
+           "\n"
+           "    buildStep(&build);\n"
+           "    buildAddInclude(&build, newDirectInclude(\"include\"));\n"
+           "    buildAddCompilationFlag(&build, \"-O1\");\n"
+           "    buildAddObject(&build, newObject(\"src/main.c\"));\n"
+           "    for (int library = 0; library < " + l + "; library++) {\n"
+           "        snprintf(path, sizeof(path), \".build/libsynth%d.a\", library);\n"
+           "        buildAddLink(&build, newPathLink(path));\n"
+           "    }\n"
+           "    buildAddLinkingFlag(&build, \"-O1\");\n"
+           "    buildStepSetOutput(&build, \"app\");\n"
+           "\n"
+           "    buildBuild(&build);\n"
+           "    return 0;\n"
+           "}\n";
+}
+
+static std::string cppScript(const Options& options) {
+    const Shape& shape = options.shape;
+    std::string  n     = std::to_string(shape.sources);
+    std::string  l     = std::to_string(shape.libraries);
+
+    return "#include \"" + (options.repo / "build.hpp").string() + "\"\n"
+           "\n"
+           "int main(int argc, char** argv) {\n"
+           "    initLog(1 << 16);\n"
+           "    Build build(\".build\", \"" + options.cxx + "\", argc, argv);\n"
+           "\n"
+           "    BuildGroup& group = build.addGroup(\"synth\");\n"
+           "    group.addInclude(Include<Direct>(\"include\"));\n"
+           "    group.addCompileFlag(\"-O1\");\n"
+           "    group.addLinkFlag(\"-O1\");\n"
+           "\n"
+           "    Task& app = group.addTask(Binary(\"app\"));\n"
+           "    app.depends_on(group.addTask(Object(\"src/main.cpp\")));\n"
+           "    for (int library = 0; library < " + l + "; library++) {\n"
+           "        Task& archive = group.addTask(Library(\"synth\" + std::to_string(library), Linkage::Static));\n"
+           "        for (int source = library * " + n + " / " + l + "; source < (library + 1) * " + n + " / " + l + "; source++) {\n"
+           "            archive.depends_on(group.addTask(Object(\"src/s\" + std::to_string(source) + \".cpp\")));\n"
+           "        }\n"
+           "        app.depends_on(archive);\n"
+           "    }\n"
+           "    for (int command = 0; command < " + std::to_string(shape.commands) + "; command++) {\n"
+           "        group.addTask(Command({\"touch\", \"stamp\" + std::to_string(command)}));\n"
+           "    }\n"
+           "\n"
+           "    build.build();\n"
+           "    return 0;\n"
+           "}\n";
+}
+
+// Sources, headers and main are the same text in both languages; only the build
+// script and the extension differ. The same seed always draws the same includes.
+static Project generate(const Options& options, const std::string& engine) {
+    const Shape& shape     = options.shape;
+    bool         cpp       = engine == "build.hpp";
+    std::string  extension = cpp ? ".cpp" : ".c";
+
+    std::filesystem::path root = options.dir / (cpp ? "cpp" : "c");
+    std::filesystem::remove_all(root);
+
+    Project project{engine, root, cpp ? "build.cpp" : "build.c", root / "src" / ("s" + std::to_string(shape.sources - 1) + extension),
+                    root / "include" / "common.h"};
+
+    std::mt19937 random(shape.seed);
+    auto         pick = [&](const std::vector<usize>& from, usize count) {
+        std::vector<usize> picked = from;
+        std::shuffle(picked.begin(), picked.end(), random);
+        picked.resize(std::min(count, picked.size()));
+        std::sort(picked.begin(), picked.end());
+        return picked;
+    };
+
+    std::vector<std::vector<usize>> layers(shape.depth);
+    for (usize header = 1; header < shape.headers; ++header) {
+        layers[layerOf(shape, header)].push_back(header);
+    }
+
+    writeFile(project.hot_header, "#pragma once\n\nstatic inline int common(int x) { return x * 7 + 3; }\n");
+
+    auto body = [](const std::string& name, usize constant, const std::vector<usize>& calls) {
+        std::string text = name + "(int x) { return x + " + std::to_string(constant);
+        for (usize call : calls) {
+            text += " + " + headerName(call) + "(x)";
+        }
+        return text + "; }\n";
+    };
+
+    for (usize header = 1; header < shape.headers; ++header) {
+        usize              layer    = layerOf(shape, header);
+        std::vector<usize> includes = layer + 1 < shape.depth ? pick(layers[layer + 1], 2) : std::vector<usize>{0};
+
+        std::string text = "#pragma once\n\n";
+        for (usize include : includes) {
+            text += "#include \"" + headerName(include) + ".h\"\n";
+        }
+        text += "\nstatic inline int " + body(headerName(header), header, includes);
+        writeFile(root / "include" / (headerName(header) + ".h"), text);
+    }
+
+    std::vector<usize> includable(shape.headers - 1);
+    std::iota(includable.begin(), includable.end(), 1);
+
+    std::string main_text;
+    for (usize source = 0; source < shape.sources; ++source) {
+        std::vector<usize> includes = pick(includable, shape.fan_in);
+
+        std::string text;
+        for (usize include : includes) {
+            text += "#include \"" + headerName(include) + ".h\"\n";
+        }
+        text += "\nint " + body("s" + std::to_string(source), source, includes);
+        writeFile(root / "src" / ("s" + std::to_string(source) + extension), text);
+
+        main_text += "int s" + std::to_string(source) + "(int x);\n";
+    }
+
+    main_text += "\nint main(int argc, char** argv) {\n    (void)argv;\n    int total = 0;\n";
+    for (usize source = 0; source < shape.sources; ++source) {
+        main_text += "    total += s" + std::to_string(source) + "(argc);\n";
+    }
+    main_text += "    return total == 0;\n}\n";
+    writeFile(root / "src" / ("main" + extension), main_text);
+
+    writeFile(root / project.script, cpp ? cppScript(options) : cScript(options));
+    return project;
+}
+
+static std::string trimmed(std::string text) {
+    while (!text.empty() && std::isspace(static_cast<unsigned char>(text.back()))) {
+        text.pop_back();
+    }
+    return text;
+}
+
+static void compileScript(const Options& options, const Project& project) {
+    Command compile({project.engine == "build.hpp" ? options.script_cxx : options.script_cc, project.script, "-o", "build"});
+    compile.setExecDir(project.root);
+
+    CommandOutput result = compile.exec();
+    if (result.exit_code != 0) {
+        RLOG(LL_FATAL, "Failed to compile " + (project.root / project.script).string() + ":\n" + result.stderr_output);
+    }
+}
+
+// Keyed by path, so a rerun that rewrote an object counts even when it landed on the
+// same coarse mtime tick as some other file.
+static std::unordered_map<std::string, std::filesystem::file_time_type> objectTimes(const std::filesystem::path& build_dir) {
+    std::unordered_map<std::string, std::filesystem::file_time_type> times;
+    if (!std::filesystem::exists(build_dir)) {
+        return times;
+    }
+    for (const auto& entry : std::filesystem::recursive_directory_iterator(build_dir)) {
+        if (entry.is_regular_file() && entry.path().extension() == ".o") {
+            times[entry.path().string()] = entry.last_write_time();
+        }
+    }
+    return times;
+}
+
+// One ./build -j N, timed from the outside — everything an engine does before its
+// first compile (parsing flags, scanning, building the graph) is part of the cost.
+static std::pair<f64, usize> runBuild(const Options& options, const Project& project) {
+    std::filesystem::path build_dir = project.root / ".build";
+    auto                  before    = objectTimes(build_dir);
+
+    Command run({"./build", "-j", std::to_string(options.jobs)});
+    run.setExecDir(project.root);
+
+    auto          start   = std::chrono::steady_clock::now();
+    CommandOutput result  = run.exec();
+    f64           seconds = std::chrono::duration<f64>(std::chrono::steady_clock::now() - start).count();
+
+    if (result.exit_code != 0) {
+        RLOG(LL_FATAL, project.engine + " build of " + project.root.string() + " failed:\n" + result.stdout_output + result.stderr_output);
+    }
+
+    usize rebuilt = 0;
+    for (const auto& [path, time] : objectTimes(build_dir)) {
+        auto previous = before.find(path);
+        rebuilt += previous == before.end() || previous->second != time;
+    }
+    return {seconds, rebuilt};
+}
+
+// Appends rather than just bumping the mtime, so an engine that ever starts hashing
+// contents still sees a real change. The explicit timestamp is the fine-grained clock,
+// never behind an object written by the run before.
+static void touch(const std::filesystem::path& path, usize generation) {
+    std::ofstream(path, std::ios::app) << "// edit " << generation << "\n";
+    std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now());
+}
+
+static std::vector<Scenario> measure(const Options& options, const Project& project) {
+    std::vector<Scenario> scenarios = {{"cold", {}, {}}, {"noop", {}, {}}, {"leaf_change", {}, {}}, {"hot_header_change", {}, {}}};
+    usize                 generation = 0;
+
+    for (Scenario& scenario : scenarios) {
+        for (usize run = 0; run < options.runs; ++run) {
+            if (scenario.name == "cold") {
+                std::filesystem::remove_all(project.root / ".build");
+            } else if (scenario.name == "leaf_change") {
+                touch(project.leaf, ++generation);
+            } else if (scenario.name == "hot_header_change") {
+                touch(project.hot_header, ++generation);
+            }
+
+            auto [seconds, rebuilt] = runBuild(options, project);
+            scenario.seconds.push_back(seconds);
+            scenario.rebuilt.push_back(rebuilt);
+        }
+
+        std::vector<f64> sorted = scenario.seconds;
+        std::sort(sorted.begin(), sorted.end());
+        printf("%-10s %-18s min %8.3f s  median %8.3f s  %6zu objects rebuilt\n", project.engine.c_str(), scenario.name.c_str(), sorted.front(),
+               sorted[sorted.size() / 2], scenario.rebuilt.back());
+        fflush(stdout);
+    }
+    return scenarios;
+}
+
+static void writeResults(const Options& options, const std::vector<std::pair<std::string, std::vector<Scenario>>>& results) {
+    const Shape& shape  = options.shape;
+    std::string  commit = trimmed(Command({"git", "-C", options.repo.string(), "rev-parse", "HEAD", "2>/dev/null"}).exec().stdout_output);
+
+    auto list = [](const auto& values) {
+        std::string text = "[";
+        for (usize i = 0; i < values.size(); ++i) {
+            char number[32];
+            if constexpr (std::is_floating_point_v<std::decay_t<decltype(values[i])>>) {
+                snprintf(number, sizeof(number), "%.6f", values[i]);
+            } else {
+                snprintf(number, sizeof(number), "%zu", values[i]);
+            }
+            text += (i > 0 ? ", " : "") + std::string(number);
+        }
+        return text + "]";
+    };
+
+    char        line[512];
+    std::string json = "{\n";
+    json += "  \"commit\": \"" + __jsonEscape(commit) + "\",\n";
+    snprintf(line, sizeof(line),
+             "  \"shape\": {\"sources\": %zu, \"headers\": %zu, \"fan_in\": %zu, \"depth\": %zu, \"libraries\": %zu, \"commands\": %zu, "
+             "\"seed\": %u},\n  \"jobs\": %d,\n  \"runs\": %zu,\n  \"results\": [\n",
+             shape.sources, shape.headers, shape.fan_in, shape.depth, shape.libraries, shape.commands, shape.seed, options.jobs, options.runs);
+    json += line;
+
+    bool first = true;
+    for (const auto& [engine, scenarios] : results) {
+        for (const Scenario& scenario : scenarios) {
+            std::vector<f64> sorted = scenario.seconds;
+            std::sort(sorted.begin(), sorted.end());
+
+            snprintf(line, sizeof(line), "    {\"engine\": \"%s\", \"scenario\": \"%s\", \"min_seconds\": %.6f, \"median_seconds\": %.6f, ",
+                     engine.c_str(), scenario.name.c_str(), sorted.front(), sorted[sorted.size() / 2]);
+            json += (first ? "" : ",\n") + std::string(line);
+            json += "\"seconds\": " + list(scenario.seconds) + ", \"rebuilt_objects\": " + list(scenario.rebuilt) + "}";
+            first = false;
+        }
+    }
+    json += "\n  ]\n}\n";
+
+    writeFile(std::filesystem::absolute(options.out), json);
+    printf("Results written to %s\n", options.out.c_str());
+}
+
+static Options parseOptions(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string flag = argv[i];
+        if (flag == "--generate-only") {
+            options.generate_only = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            RLOG(LL_FATAL, "Missing value for " + flag);
+        }
+
+        std::string value = argv[++i];
+        auto        count = [&] { return static_cast<usize>(std::strtoull(value.c_str(), nullptr, 10)); };
+        if (flag == "--sources") {
+            options.shape.sources = count();
+        } else if (flag == "--headers") {
+            options.shape.headers = count();
+        } else if (flag == "--fan-in") {
+            options.shape.fan_in = count();
+        } else if (flag == "--depth") {
+            options.shape.depth = count();
+        } else if (flag == "--libraries") {
+            options.shape.libraries = count();
+        } else if (flag == "--commands") {
+            options.shape.commands = count();
+        } else if (flag == "--seed") {
+            options.shape.seed = static_cast<u32>(count());
+        } else if (flag == "-j") {
+            options.jobs = std::max(1, std::atoi(value.c_str()));
+        } else if (flag == "--runs") {
+            options.runs = std::max<usize>(1, count());
+        } else if (flag == "--engine") {
+            options.engine = value;
+        } else if (flag == "--dir") {
+            options.dir = value;
+        } else if (flag == "--out") {
+            options.out = value;
+        } else if (flag == "--repo") {
+            options.repo = value;
+        } else if (flag == "--cc") {
+            options.cc = value;
+        } else if (flag == "--cxx") {
+            options.cxx = value;
+        } else if (flag == "--script-cc") {
+            options.script_cc = value;
+        } else if (flag == "--script-cxx") {
+            options.script_cxx = value;
+        } else {
+            RLOG(LL_FATAL, "Unknown flag " + flag);
+        }
+    }
+
+    Shape& shape = options.shape;
+    if (shape.sources == 0 || shape.headers < 2 || shape.fan_in == 0 || shape.depth == 0 || shape.libraries == 0) {
+        RLOG(LL_FATAL, "--sources, --fan-in, --depth and --libraries must be at least 1, and --headers at least 2");
+    }
+    if (options.engine != "both" && options.engine != "c" && options.engine != "cpp") {
+        RLOG(LL_FATAL, "--engine must be one of both, c, cpp");
+    }
+    // Every layer needs at least one header, and every library at least one source.
+    shape.depth     = std::min(shape.depth, shape.headers - 1);
+    shape.libraries = std::min(shape.libraries, shape.sources);
+
+    options.repo = std::filesystem::absolute(options.repo).lexically_normal();
+    options.dir  = std::filesystem::absolute(options.dir);
+    if (!std::filesystem::exists(options.repo / "build.h") || !std::filesystem::exists(options.repo / "build.hpp")) {
+        RLOG(LL_FATAL, "No build.h/build.hpp in " + options.repo.string() + " — run from the repo root or pass --repo");
+    }
+    return options;
+}
+
+int main(int argc, char** argv) {
+    initLog(1 << 16);
+
+    Options options = parseOptions(argc, argv);
+
+    std::vector<std::string> engines;
+    if (options.engine != "cpp") {
+        engines.push_back("build.h");
+    }
+    if (options.engine != "c") {
+        engines.push_back("build.hpp");
+    }
+
+    std::vector<std::pair<std::string, std::vector<Scenario>>> results;
+    for (const std::string& engine : engines) {
+        Project project = generate(options, engine);
+        if (options.generate_only) {
+            printf("Generated %s project in %s\n", engine.c_str(), project.root.c_str());
+            continue;
+        }
+
+        compileScript(options, project);
+        results.emplace_back(engine, measure(options, project));
+    }
+
+    if (!options.generate_only) {
+        writeResults(options, results);
+    }
+    return 0;
+}
@@ -0,0 +1,84 @@
+// Dispatch-overhead microbenchmark for ThreadPool: 100k no-op tasks, so everything
+// measured is scheduling — deque pushes, steals, wakeups and completion bookkeeping.
+// No Build is involved (constructing one would trigger selfRebuild), just Tasks wired
+// together by hand, frozen into a TaskGraph, and a pool with no runner.
+//
+//     g++ -std=c++23 -O2 -pthread bench/threadpool_bench.cpp -o threadpool_bench
+//     ./threadpool_bench [threads] [tasks]
+
+#include "../build.hpp"
+
+#include <deque>
+
+// depends_on() keeps raw pointers to Tasks — deque gives stable addresses without a
+// heap allocation each, the same as Build's own task pool.
+static f64 dispatch(std::deque<Task>& tasks, i32 threads) {
+    ThreadPool pool;
+    TaskGraph  graph;
+
+    std::vector<Task*> pointers;
+    for (Task& task : tasks) {
+        pointers.push_back(&task);
+    }
+    graph.freeze(pointers);
+
+    std::vector<Task*> roots;
+    for (u32 id : graph.roots()) {
+        roots.push_back(graph.task(id));
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    pool.start(threads);
+    pool.beginDispatch(graph.size());
+    pool.pushWork(roots);
+    pool.waitDrained();
+    pool.waitAll();
+
+    return std::chrono::duration<f64>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void report(const char* shape, usize count, f64 seconds) {
+    printf("%-8s %8zu tasks  %9.2f ms  %8.1f ns/task\n", shape, count, seconds * 1e3, seconds * 1e9 / static_cast<f64>(count));
+}
+
+int main(int argc, char** argv) {
+    i32   threads = argc > 1 ? std::atoi(argv[1]) : static_cast<i32>(std::thread::hardware_concurrency());
+    usize count   = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 100000;
+
+    printf("%d worker threads\n", threads);
+
+    // Every task a root: all of it goes through the injection queue.
+    {
+        std::deque<Task> tasks;
+        for (usize i = 0; i < count; ++i) {
+            tasks.emplace_back(Output(Command{}));
+        }
+        report("flat", count, dispatch(tasks, threads));
+    }
+
+    // Binary tree: each completion unblocks two children, one kept local and one left
+    // up for stealing — the path that actually exercises the deques.
+    {
+        std::deque<Task> tasks;
+        for (usize i = 0; i < count; ++i) {
+            Task& task = tasks.emplace_back(Output(Command{}));
+            if (i > 0) {
+                task.depends_on(tasks[(i - 1) / 2]);
+            }
+        }
+        report("tree", count, dispatch(tasks, threads));
+    }
+
+    // Wide fan-out: one root releasing everything at once.
+    {
+        std::deque<Task> tasks;
+        tasks.emplace_back(Output(Command{}));
+        for (usize i = 1; i < count; ++i) {
+            tasks.emplace_back(Output(Command{})).depends_on(tasks[0]);
+        }
+        report("fan-out", count, dispatch(tasks, threads));
+    }
+
+    return 0;
+}
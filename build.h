@@ -208,52 +208,108 @@ void __Log_impl(LogLevel level, const char* file, u32 line, const char* fmt, ...
     struct {}
 
 // Arena Allocator for general use (internal use only)
-typedef struct {
-        char* data;
-        usize offset;
+//
+// Memory comes in chunks that are linked together as they fill up, so there is no size
+// to tune and running out only happens when malloc does. Every thread bumps through a
+// chunk of its own, so allocating never takes a lock; the mutex is only held to record
+// a freshly malloc'd chunk in the list freeArena walks. Allocations outlive the thread
+// that made them: a worker's object paths are still read after the pool stops.
+typedef struct __ArenaChunk {
+        struct __ArenaChunk* prev; // The owning thread's previous chunk
+        struct __ArenaChunk* next_owned; // Every chunk of every thread, for freeArena
+        usize used;
         usize capacity;
-} __Arena;
+        char data[];
+} __ArenaChunk;
+
+// Where the calling thread's bump pointer stood when a scratch scope began
+typedef struct {
+        __ArenaChunk* chunk;
+        usize used;
+        __ArenaChunk* prev_chunk;
+        usize prev_used;
+} ArenaScratch;
+
+#define __ARENA_DEFAULT_CHUNK_SIZE (1024 * 1024)
 
 static pthread_mutex_t __arena_mutex = PTHREAD_MUTEX_INITIALIZER;
+static __ArenaChunk* __arena_chunks = nullptr;
+static atomic_size_t __arena_chunk_size = __ARENA_DEFAULT_CHUNK_SIZE;
+
+static thread_local __ArenaChunk* __arena_current = nullptr;
+static thread_local __ArenaChunk* __arena_free = nullptr; // Chunks handed back by arenaScratchEnd
+static thread_local ArenaScratch __arena_mark = {0};
 
-static __Arena __arena = {nullptr, 0, 0};
 static bool build_success = true;
 
-void initArena(usize size) { __arena = (__Arena){.data = (char*)malloc(size), .offset = 0, .capacity = size}; }
-void freeArena() { free(__arena.data); }
+// Optional: sets the size of each chunk. The arena grows on demand either way.
+void initArena(usize size) { atomic_store(&__arena_chunk_size, size > 0 ? size : __ARENA_DEFAULT_CHUNK_SIZE); }
 
-char* arenaAlloc(usize size) {
+void freeArena() {
     pthread_mutex_lock(&__arena_mutex);
-    RLOG(LL_TRACE, "Aquired Mutex");
+    __ArenaChunk* chunk = __arena_chunks;
+    while (chunk) {
+        __ArenaChunk* next = chunk->next_owned;
+        free(chunk);
+        chunk = next;
+    }
+    __arena_chunks = nullptr;
+    pthread_mutex_unlock(&__arena_mutex);
 
-    usize alignment = sizeof(void*);
+    __arena_current = nullptr;
+    __arena_free = nullptr;
+    __arena_mark = (ArenaScratch){0};
+}
 
-    usize current_ptr = (usize)(__arena.data + __arena.offset);
-    usize padding = 0;
-    if (current_ptr % alignment != 0) {
-        padding = alignment - (current_ptr % alignment);
+// ! Internal use only
+// Slow path: reuse a chunk left over from a scratch scope, or malloc a new one
+__ArenaChunk* __arenaGrow(usize size) {
+    usize capacity = atomic_load(&__arena_chunk_size);
+    if (size > capacity) {
+        capacity = size;
     }
 
-    if (__arena.data == nullptr && __arena.capacity == 0 && __arena.offset == 0) {
-        pthread_mutex_unlock(&__arena_mutex);
-        RLOG(LL_TRACE, "Released Mutex");
-        RLOG(LL_FATAL, "Arena must be initialized before the build script can run");
+    __ArenaChunk* chunk = nullptr;
+    for (__ArenaChunk** free_chunk = &__arena_free; *free_chunk; free_chunk = &(*free_chunk)->prev) {
+        if ((*free_chunk)->capacity >= size) {
+            chunk = *free_chunk;
+            *free_chunk = chunk->prev;
+            break;
+        }
     }
 
-    if (__arena.offset + padding + size > __arena.capacity) {
-        freeArena();
+    if (chunk == nullptr) {
+        chunk = (__ArenaChunk*)malloc(sizeof(__ArenaChunk) + capacity);
+        if (chunk == nullptr) {
+            RLOG(LL_FATAL, "Arena out of memory: failed to allocate a %zu byte chunk", capacity);
+        }
+        chunk->capacity = capacity;
+
+        pthread_mutex_lock(&__arena_mutex);
+        chunk->next_owned = __arena_chunks;
+        __arena_chunks = chunk;
         pthread_mutex_unlock(&__arena_mutex);
-        RLOG(LL_TRACE, "Released Mutex");
-        RLOG(LL_FATAL, "Arena out of memory, use bigger arena size");
     }
 
-    __arena.offset += padding;
+    chunk->used = 0;
+    chunk->prev = __arena_current;
+    __arena_current = chunk;
+    return chunk;
+}
 
-    char* ret = __arena.data + __arena.offset;
-    __arena.offset += size;
-    pthread_mutex_unlock(&__arena_mutex);
-    RLOG(LL_TRACE, "Released Mutex");
-    return ret;
+char* arenaAlloc(usize size) {
+    const usize alignment = sizeof(void*);
+
+    __ArenaChunk* chunk = __arena_current;
+    usize offset = chunk ? (chunk->used + alignment - 1) & ~(alignment - 1) : 0;
+
+    if (chunk == nullptr || offset + size > chunk->capacity) {
+        chunk = __arenaGrow(size);
+        offset = 0;
+    }
+
+    chunk->used = offset + size;
+    return chunk->data + offset;
 }
 
 char* arenaCalloc(usize size) {
@@ -265,35 +321,69 @@ char* arenaCalloc(usize size) {
 // Just allocate new memory because we don't care about fragmentation for this small of a program
 char* arenaRealloc(char* data, usize old_size, usize size) {
     if (data == nullptr) {
-        RLOG(LL_DEBUG, "data pointer is null... Creating new allocation");
         return arenaAlloc(size);
     }
 
-    RLOG(LL_TRACE, "Checking if data pointer is part of the arena");
-    pthread_mutex_lock(&__arena_mutex);
-    RLOG(LL_TRACE, "Aquired Mutex");
-    if (data < __arena.data || data > __arena.data + __arena.capacity) {
-        freeArena();
-        pthread_mutex_unlock(&__arena_mutex);
-        RLOG(LL_TRACE, "Released Mutex");
-        RLOG(LL_FATAL, "data pointer is not part of the arena");
-    }
-
-    if (data + old_size == __arena.data + __arena.offset) {
-        // Extend in place
-        __arena.offset += (size - old_size);
-        pthread_mutex_unlock(&__arena_mutex);
-        RLOG(LL_TRACE, "Released Mutex");
+    // Extend in place when data is this thread's latest allocation. Not across the start
+    // of a scratch scope though: arenaScratchEnd would hand the extension back.
+    __ArenaChunk* chunk = __arena_current;
+    if (chunk && data + old_size == chunk->data + chunk->used && size <= (usize)(chunk->data + chunk->capacity - data)
+        && (chunk != __arena_mark.chunk || data >= chunk->data + __arena_mark.used)) {
+        chunk->used = (usize)(data - chunk->data) + size;
         return data;
     }
-    pthread_mutex_unlock(&__arena_mutex);
-    RLOG(LL_TRACE, "Released Mutex");
 
     char* new_data = (char*)arenaAlloc(size);
-    memcpy(new_data, data, old_size);
+    memcpy(new_data, data, old_size < size ? old_size : size);
     return new_data;
 }
 
+/**
+ * @brief Starts a scratch scope on the calling thread.
+ *
+ * Everything this thread allocates until the matching arenaScratchEnd() is handed back
+ * to the arena, so temporaries like rendered command lines don't pile up over a build.
+ * Scopes nest, but must end in reverse order on the thread that started them, and
+ * nothing allocated inside one may be kept after it ends.
+ *
+ * @return The mark to pass to arenaScratchEnd()
+ */
+ArenaScratch arenaScratchBegin() {
+    ArenaScratch scratch = {
+        .chunk = __arena_current,
+        .used = __arena_current ? __arena_current->used : 0,
+        .prev_chunk = __arena_mark.chunk,
+        .prev_used = __arena_mark.used,
+    };
+
+    __arena_mark = (ArenaScratch){.chunk = scratch.chunk, .used = scratch.used};
+    return scratch;
+}
+
+/**
+ * @brief Ends a scratch scope, releasing everything allocated since arenaScratchBegin().
+ *
+ * Chunks filled inside the scope are kept on a per-thread free list for later scopes
+ * instead of going back to malloc.
+ *
+ * @param scratch The mark returned by arenaScratchBegin()
+ */
+void arenaScratchEnd(ArenaScratch scratch) {
+    while (__arena_current != scratch.chunk) {
+        __ArenaChunk* chunk = __arena_current;
+        __arena_current = chunk->prev;
+
+        chunk->prev = __arena_free;
+        __arena_free = chunk;
+    }
+
+    if (__arena_current) {
+        __arena_current->used = scratch.used;
+    }
+
+    __arena_mark = (ArenaScratch){.chunk = scratch.prev_chunk, .used = scratch.prev_used};
+}
+
 // --- Vector ---
 
 #define Vector(type)                                                                                                                                 \
@@ -554,10 +644,12 @@ void cmdPrint(Command* cmd) {
 
     // print the full path if we are verbose logging
     if (__log_verbose) {
+        ArenaScratch scratch = arenaScratchBegin();
         usize cmd_len = __cmdlen(cmd);
         char* command = (char*)arenaAlloc(cmd_len);
         __cmdSnprint(cmd, cmd_len, command);
         RLOG(LL_TRACE, "%s", command);
+        arenaScratchEnd(scratch);
     }
 
     usize cmd_buf_offset = 0;
@@ -649,6 +741,9 @@ u32 cmdExec(Command* cmd) {
     //     chdir(cmd->exec_dir);
     // }
 
+    // The rendered command line is only needed until system() returns
+    ArenaScratch scratch = arenaScratchBegin();
+
     // usize command_size = strlen(cmd->command_chain[0]) + 1;
     usize command_size = __cmdlen(cmd);
     char* command = (char*)arenaCalloc(command_size);
@@ -667,6 +762,7 @@ u32 cmdExec(Command* cmd) {
     }
 
     u32 result = system(command);
+    arenaScratchEnd(scratch);
 
     // if (cmd->exec_dir) {
     //     chdir(cwd);
@@ -876,8 +972,6 @@ void __objBuild(
     __CompCmdVec* comp_cmds,
     pthread_mutex_t* comp_cmd_mutex
 ) {
-    __DependencyList deps_list = __objListDeps(obj, compiler, flags, includes);
-
     Command cmd = newCommand(compiler, flags, includes);
     char** build_command = __objBuildCommand(obj, build_dir);
 
@@ -890,6 +984,15 @@ void __objBuild(
     VectorPushBack(CompileCommand, comp_cmds, newCompileCommand(&cmd, obj->src_path));
     pthread_mutex_unlock(comp_cmd_mutex);
 
+    pthread_mutex_lock(obj_files_mutex);
+    VectorPushBack(char*, obj_files, build_command[3]);
+    pthread_mutex_unlock(obj_files_mutex);
+
+    // Everything above outlives this job. The dependency list and the compiler output
+    // below don't, so they go in a scratch scope.
+    ArenaScratch scratch = arenaScratchBegin();
+    __DependencyList deps_list = __objListDeps(obj, compiler, flags, includes);
+
     // Check if the object file needs a rebuild
     bool needs_rebuild = true;
     struct stat attr;
@@ -915,10 +1018,6 @@ void __objBuild(
         }
     }
 
-    pthread_mutex_lock(obj_files_mutex);
-    VectorPushBack(char*, obj_files, build_command[3]);
-    pthread_mutex_unlock(obj_files_mutex);
-
     if (needs_rebuild) {
         cmdPrint(&cmd);
         u32 ret_code = cmdExec(&cmd);
@@ -930,73 +1029,139 @@ void __objBuild(
     } else {
         RLOG(LL_DEBUG, "Skipping Object file build %s", build_command[3]);
     }
+
+    arenaScratchEnd(scratch);
 }
 
-// Object queue
+// Thread pool
 
 // ! Internal use only
 typedef struct {
-        Object** objects;
-        Object** start;
-        Object** end;
-        usize cap;
-} __ObjectQueue;
+        void (*run)(void* arg);
+        void* arg;
+} __Job;
 
 // ! Internal use only
-__ObjectQueue __newObjectQueue(usize cap) {
-    __ObjectQueue queue = {0};
+// One queue shared by every worker rather than one per thread: whichever thread is
+// free takes the next job, so a slow file only ever holds up the thread compiling it.
+// Idle workers sleep on has_work instead of polling, and the threads live for the
+// whole build instead of being created and joined for every step.
+typedef struct {
+        pthread_mutex_t mutex;
+        pthread_cond_t has_work;
+        pthread_cond_t idle;
+
+        // Ring buffer, grown by __poolPush when full
+        __Job* jobs;
+        usize head;
+        usize len;
+        usize cap;
 
-    queue.objects = (Object**)arenaAlloc(cap * sizeof(Object*));
-    queue.start = queue.objects;
-    queue.end = queue.objects;
-    queue.cap = cap;
+        // Queued plus currently running, so __poolWait knows when everything is done
+        usize pending;
+        bool shutdown;
 
-    return queue;
-}
+        pthread_t* threads;
+        usize thread_count;
+} __ThreadPool;
 
 // ! Internal use only
-void __objQPush(__ObjectQueue* q, Object* obj) {
-    Object** next_end = q->end + 1;
-    if (next_end >= q->objects + q->cap) {
-        next_end = q->objects;
-    }
+void* __poolWorker(void* arg) {
+    __ThreadPool* pool = (__ThreadPool*)arg;
 
-    if (next_end == q->start) {
-    build_h___objQPush__obj_q_push_rerun:
-        usize start_offset = q->start - q->objects;
-        usize end_offset = q->end - q->objects;
+    pthread_mutex_lock(&pool->mutex);
+    while (true) {
+        while (pool->len == 0 && !pool->shutdown) {
+            pthread_cond_wait(&pool->has_work, &pool->mutex);
+        }
+
+        if (pool->len == 0) {
+            break;
+        }
 
-        q->objects = (Object**)arenaRealloc((char*)q->objects, q->cap * sizeof(Object*), q->cap * 2 * sizeof(Object*));
-        q->cap *= 2;
+        __Job job = pool->jobs[pool->head];
+        pool->head = (pool->head + 1) % pool->cap;
+        pool->len--;
 
-        // Put the pointers back
-        // q->start = q->objects + (q->start - q->objects);
-        // q->end = q->objects + (q->end - q->objects);
-        q->start = q->objects + start_offset;
-        q->end = q->objects + end_offset;
+        pthread_mutex_unlock(&pool->mutex);
+        job.run(job.arg);
+        pthread_mutex_lock(&pool->mutex);
 
-        next_end = q->end + 1;
-        if (next_end >= q->objects + q->cap) {
-            goto build_h___objQPush__obj_q_push_rerun;
+        pool->pending--;
+        if (pool->pending == 0) {
+            pthread_cond_broadcast(&pool->idle);
         }
     }
+    pthread_mutex_unlock(&pool->mutex);
 
-    *q->end = obj;
-    q->end = next_end;
+    return nullptr;
 }
 
 // ! Internal use only
-Object* __objQPop(__ObjectQueue* q) {
-    if (q->start == q->end) {
-        return nullptr;
+void __poolStart(__ThreadPool* pool, usize thread_count) {
+    *pool = (__ThreadPool){0};
+    pthread_mutex_init(&pool->mutex, nullptr);
+    pthread_cond_init(&pool->has_work, nullptr);
+    pthread_cond_init(&pool->idle, nullptr);
+
+    pool->cap = 64;
+    pool->jobs = (__Job*)arenaAlloc(pool->cap * sizeof(__Job));
+
+    pool->thread_count = thread_count;
+    pool->threads = (pthread_t*)arenaCalloc(thread_count * sizeof(pthread_t));
+    for (usize i = 0; i < thread_count; i++) {
+        pthread_create(&pool->threads[i], nullptr, __poolWorker, pool);
     }
+}
+
+// ! Internal use only
+void __poolPush(__ThreadPool* pool, __Job job) {
+    pthread_mutex_lock(&pool->mutex);
+
+    if (pool->len == pool->cap) {
+        // Unwrap into the new buffer so the ring starts at 0 again
+        __Job* jobs = (__Job*)arenaAlloc(pool->cap * 2 * sizeof(__Job));
+        for (usize i = 0; i < pool->len; i++) {
+            jobs[i] = pool->jobs[(pool->head + i) % pool->cap];
+        }
 
-    Object* obj = *q->start;
-    q->start++;
-    if (q->start >= q->objects + q->cap) {
-        q->start = q->objects;
+        pool->jobs = jobs;
+        pool->head = 0;
+        pool->cap *= 2;
     }
-    return obj;
+
+    pool->jobs[(pool->head + pool->len) % pool->cap] = job;
+    pool->len++;
+    pool->pending++;
+
+    pthread_cond_signal(&pool->has_work);
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+// ! Internal use only
+// Blocks until every job pushed so far has finished running
+void __poolWait(__ThreadPool* pool) {
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->pending > 0) {
+        pthread_cond_wait(&pool->idle, &pool->mutex);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+// ! Internal use only
+void __poolStop(__ThreadPool* pool) {
+    pthread_mutex_lock(&pool->mutex);
+    pool->shutdown = true;
+    pthread_cond_broadcast(&pool->has_work);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for (usize i = 0; i < pool->thread_count; i++) {
+        pthread_join(pool->threads[i], nullptr);
+    }
+
+    pthread_cond_destroy(&pool->idle);
+    pthread_cond_destroy(&pool->has_work);
+    pthread_mutex_destroy(&pool->mutex);
 }
 
 // Link
@@ -1096,6 +1261,8 @@ typedef Vector(LinkedObject) __LinkedObjVec;
 
 typedef Vector(Link) __LinkVec;
 
+typedef Vector(usize) __StepIndexVec;
+
 typedef struct {
         char* compiler;
         char* output_file;
@@ -1106,22 +1273,12 @@ typedef struct {
         __LinkVec links;
         __StrVec comp_flags;
         __StrVec link_flags;
+        __StepIndexVec depends_on;
         bool skip_linking;
 } __BuildStep;
 
 typedef Vector(__BuildStep) __BuildStepVec;
 
-typedef struct {
-        pthread_mutex_t mutex;
-
-        atomic_bool all_jobs_queued;
-        atomic_bool all_jobs_complete;
-
-        __ObjectQueue objects;
-} __BuildJob;
-
-typedef Vector(__BuildJob) __BuildJobVec;
-
 typedef struct {
         enum {
             Os_Invalid,
@@ -1145,7 +1302,6 @@ typedef struct {
         char* __default_compiler;
 
         __BuildStepVec __build_steps;
-        __BuildJobVec __build_jobs;
         usize __jobs;
 
         bool __skip_compile_commands;
@@ -1251,7 +1407,6 @@ void __initCommon(Build* build) {
 
     build->__skip_compile_commands = false;
     build->__jobs = 1;
-    build->__build_jobs = (__BuildJobVec){0};
 
     build->builtin = (Builtin){
         .os = Os_Invalid,
@@ -1538,6 +1693,29 @@ void buildStepSetOutput(Build* build, char* output_file) {
     build->__build_steps.items[build_step_index].output_file = output_file;
 }
 
+/**
+ * @brief Makes the current build step wait for an earlier step to finish.
+ *
+ * Build steps are scheduled as one graph, so steps that don't reference each
+ * other's objects compile concurrently. Dependencies through buildAddLinkedObject
+ * are found automatically, and pre-build commands still wait for every earlier
+ * step. Anything else one step needs from another, such as a header generated by
+ * an earlier step's output, has to be declared here. The current step's compiles
+ * then don't start until the given step has been fully built and linked.
+ *
+ * @param build Pointer to the Build structure to modify
+ * @param step Index of an earlier build step (the first step is 0)
+ */
+void buildStepDependsOn(Build* build, usize step) {
+    usize build_step_index = build->__build_steps.len - 1;
+    if (step >= build_step_index) {
+        RLOG(LL_FATAL, "Build step %zu can only depend on an earlier step, not %zu", build_step_index, step);
+    }
+
+    __StepIndexVec* vec = &build->__build_steps.items[build_step_index].depends_on;
+    VectorPushBack(usize, vec, step);
+}
+
 /**
  * @brief Creates a new build step in the build pipeline.
  *
@@ -1568,276 +1746,314 @@ void buildStep(Build* build) {
     step->compiler = build->__default_compiler;
 }
 
+// ! Internal use only
+// A job plus its place in the build graph. When a node finishes, every child whose
+// last unfinished parent it was gets pushed onto the pool.
+typedef struct __GraphNode {
+        void (*run)(void* arg);
+        void* arg;
+        __ThreadPool* pool;
+        atomic_size_t pending_parents;
+        Vector(struct __GraphNode*) children;
+} __GraphNode;
+
+typedef Vector(__GraphNode*) __NodeVec;
+
+// ! Internal use only
+__GraphNode* __newNode(__NodeVec* nodes, __ThreadPool* pool, void (*run)(void*), void* arg) {
+    __GraphNode* node = (__GraphNode*)arenaCalloc(sizeof(__GraphNode));
+    node->run = run;
+    node->arg = arg;
+    node->pool = pool;
+    atomic_init(&node->pending_parents, 0);
+
+    VectorPushBack(__GraphNode*, nodes, node);
+    return node;
+}
+
+// ! Internal use only
+void __nodeDependsOn(__GraphNode* node, __GraphNode* parent) {
+    VectorPushBack(__GraphNode*, &parent->children, node);
+    atomic_fetch_add(&node->pending_parents, 1);
+}
+
+// ! Internal use only
+// Children are pushed before this job counts as finished in the pool, so __poolWait
+// can't see the pool go idle while part of the graph is still unscheduled
+void __runNode(void* arg) {
+    __GraphNode* node = (__GraphNode*)arg;
+    node->run(node->arg);
+
+    for (usize i = 0; i < node->children.len; i++) {
+        __GraphNode* child = node->children.items[i];
+        if (atomic_fetch_sub(&child->pending_parents, 1) == 1) {
+            __poolPush(node->pool, (__Job){.run = __runNode, .arg = child});
+        }
+    }
+}
+
+// ! Internal use only
+// Everything one build step's jobs share. Flags and includes are joined into strings
+// once per step here, not once per object by every worker.
 typedef struct {
         Build* build;
-        __StrVec includes;
         __BuildStep* step;
-        __StrVec* obj_files;
-        pthread_mutex_t* obj_mutex;
+        usize step_index;
+        char* compiler;
+        char* includes;
+        char* comp_flags;
+        __StrVec obj_files;
+        pthread_mutex_t obj_mutex;
         __CompCmdVec* compile_cmds;
         pthread_mutex_t* comp_cmd_mutex;
-        usize job_number;
-} __CompileThreadArgs;
+} __StepState;
 
 // ! Internal use only
-void* __threadedCompile(void* arg) {
-    __CompileThreadArgs* args = (__CompileThreadArgs*)arg;
-    __BuildJob* build_jobs = args->build->__build_jobs.items;
-
-    pthread_mutex_lock(&build_jobs[args->job_number].mutex);
-    RLOG(LL_TRACE, "Locked jobs %d mutex", args->job_number);
-    __ObjectQueue* q = &build_jobs[args->job_number].objects;
-
-    bool q_is_empty = q->start == q->end;
-    bool all_jobs_queued = build_jobs[args->job_number].all_jobs_queued;
-    pthread_mutex_unlock(&build_jobs[args->job_number].mutex);
-    RLOG(LL_TRACE, "Unlocked jobs %d mutex", args->job_number);
-
-    while (!q_is_empty || !all_jobs_queued) {
-        if (!q_is_empty) {
-            pthread_mutex_lock(&build_jobs[args->job_number].mutex);
-            RLOG(LL_TRACE, "Locked jobs %d mutex", args->job_number);
-            Object* obj = __objQPop(q);
-            pthread_mutex_unlock(&build_jobs[args->job_number].mutex);
-            RLOG(LL_TRACE, "Unlocked jobs %d mutex", args->job_number);
-
-            // Concatenate all the includes into 1 string
-            usize includes_cap = MAX(1, PATH_MAX * args->includes.len);
-            char* includes_str = (char*)arenaCalloc(PATH_MAX * args->includes.len);
-            usize includes_offset = 0;
-            for (usize i = 0; i < args->includes.len; i++) {
-                char* inc = args->includes.items[i];
-                usize inc_len = strlen(inc);
-                if (includes_offset + inc_len > includes_cap) {
-                    usize new_inc_cap = MAX(includes_cap * 2, includes_cap + inc_len);
-                    includes_str = (char*)arenaRealloc(includes_str, includes_cap, new_inc_cap * sizeof(char));
-                    includes_cap = new_inc_cap;
-                }
+typedef struct {
+        __StepState* step;
+        Object* obj;
+} __CompileJobArgs;
 
-                strcat(includes_str, inc);
-                strcat(includes_str, " ");
-            }
+// ! Internal use only
+char* __joinStrings(__StrVec* strings) {
+    usize len = 1;
+    for (usize i = 0; i < strings->len; i++) {
+        len += strlen(strings->items[i]) + 1;
+    }
 
-            // Concatenate all the compilation flags into 1 string
-            usize flags_cap = MAX(1, PATH_MAX * args->step->comp_flags.len);
-            char* comp_flags_str = (char*)arenaCalloc(flags_cap);
-            usize flags_offset = 0;
-            for (usize i = 0; i < args->step->comp_flags.len; i++) {
-                char* flag = args->step->comp_flags.items[i];
-                usize flag_len = strlen(flag);
-                if (flags_offset + flag_len > flags_cap) {
-                    usize new_flag_cap = MAX(flags_cap * 2, flags_cap + flag_len);
-                    comp_flags_str = (char*)arenaRealloc(comp_flags_str, flags_cap, new_flag_cap * sizeof(char));
-                    flags_cap = new_flag_cap;
-                }
+    char* joined = (char*)arenaCalloc(len);
+    for (usize i = 0; i < strings->len; i++) {
+        strcat(joined, strings->items[i]);
+        strcat(joined, " ");
+    }
 
-                strcat(comp_flags_str, flag);
-                strcat(comp_flags_str, " ");
-            }
+    return joined;
+}
 
-            char* compiler_to_use;
-            if (args->step->compiler) {
-                compiler_to_use = args->step->compiler;
-            } else {
-                compiler_to_use = args->build->__default_compiler;
-            }
+// ! Internal use only
+void __preStepJob(void* arg) {
+    __StepState* state = (__StepState*)arg;
+    __BuildStep* step = state->step;
 
-            __objBuild(
-                obj, compiler_to_use, comp_flags_str, includes_str, args->build->__build_dir, args->obj_files, args->obj_mutex, args->compile_cmds,
-                args->comp_cmd_mutex
-            );
-        }
+    for (usize i = 0; i < step->pre_step_commands.len; i++) {
+        Command* cmd = &step->pre_step_commands.items[i];
+        cmdPrint(cmd);
+        u32 result = cmdExec(cmd);
 
-        pthread_mutex_lock(&build_jobs[args->job_number].mutex);
-        RLOG(LL_TRACE, "Locked jobs %d mutex", args->job_number);
-        q_is_empty = q->start == q->end;
-        all_jobs_queued = build_jobs[args->job_number].all_jobs_queued;
-        pthread_mutex_unlock(&build_jobs[args->job_number].mutex);
-        RLOG(LL_TRACE, "Unlocked jobs %d mutex", args->job_number);
+        if (result != 0) {
+            RLOG(LL_FATAL, "Error executing command");
+        }
     }
+}
 
-    build_jobs[args->job_number].all_jobs_complete = true;
-
-    return nullptr;
+// ! Internal use only
+void __compileJob(void* arg) {
+    __CompileJobArgs* job = (__CompileJobArgs*)arg;
+    __StepState* step = job->step;
+
+    __objBuild(
+        job->obj, step->compiler, step->comp_flags, step->includes, step->build->__build_dir, &step->obj_files, &step->obj_mutex, step->compile_cmds,
+        step->comp_cmd_mutex
+    );
 }
 
-void buildBuild(Build* build) {
-    build->__build_jobs = (__BuildJobVec){
-        .items = (void*)arenaAlloc(sizeof(__BuildJob) * build->__jobs),
-        .len = 0,
-        .cap = build->__jobs,
-    };
+// ! Internal use only
+void __linkStepJob(void* arg) {
+    __StepState* state = (__StepState*)arg;
+    __BuildStep* step = state->step;
+    Build* build = state->build;
 
-    for (usize i = 0; i < build->__jobs; i++) {
-        __BuildJob job = (__BuildJob){
-            .all_jobs_queued = false,
-            .all_jobs_complete = false,
-            .objects = __newObjectQueue(100),
-        };
+    if (!build_success) {
+        RLOG(LL_FATAL, "Build failed");
+    }
 
-        VectorPushBack(__BuildJob, &build->__build_jobs, job);
-        pthread_mutex_init(&build->__build_jobs.items[i].mutex, nullptr);
+    if (step->skip_linking) {
+        return;
     }
 
-    __CompCmdVec compile_commands = (__CompCmdVec){0};
-    pthread_mutex_t comp_command_mutex = PTHREAD_MUTEX_INITIALIZER;
+    if (step->output_file == nullptr) {
+        RLOG(LL_FATAL, "Output file not specified");
+    }
 
-    for (int step_index = 0; step_index < build->__build_steps.len; step_index++) {
-        RLOG(LL_INFO, "========== RUNNING BUILD STEP %d ==========", step_index + 1);
-        __BuildStep* step = &build->__build_steps.items[step_index];
+    RLOG(LL_INFO, "========== LINKING BUILD STEP %zu ==========", state->step_index + 1);
 
-        // Run the prebuild commands
-        for (usize i = 0; i < step->pre_step_commands.len; i++) {
-            Command* cmd = &step->pre_step_commands.items[i];
-            cmdPrint(cmd);
-            u32 result = cmdExec(cmd);
+    char output_file[PATH_MAX];
+    snprintf(output_file, PATH_MAX, "%s/%s", build->__build_dir, step->output_file);
 
-            if (result != 0) {
-                RLOG(LL_FATAL, "Error executing command");
-            }
-        }
+    usize output_len = strlen(step->output_file);
+    bool archive = output_len > 2 && strcmp(step->output_file + output_len - 2, ".a") == 0;
 
-        // Create the build step includes paths
-        __StrVec includes = (__StrVec){0};
-        for (usize i = 0; i < step->includes.len; i++) {
-            Include* inc = &step->includes.items[i];
+    Command linking_cmd;
+    if (archive) {
+        remove(output_file); // Rebuild from scratch so members of deleted sources don't linger
+        linking_cmd = newCommand("ar", "rcs", output_file);
+    } else {
+        linking_cmd = newCommand(state->compiler);
 
-            VectorPushBack(char*, &includes, "-I");
-            char* inc_path = __includePath(inc, build->__symlink_dir);
-            VectorPushBack(char*, &includes, inc_path);
+        if (step->link_flags.len == 0) {
+            // TODO: review
+            // By default use the c23 standard
+            cmdPushBack(&linking_cmd, "-std=c23");
+        } else {
+            for (usize i = 0; i < step->link_flags.len; i++) {
+                cmdPushBack(&linking_cmd, step->link_flags.items[i]);
+            }
         }
 
-        // Create the build step object files
-        __StrVec object_files = (__StrVec){0};
-        pthread_mutex_t obj_files_mutex = PTHREAD_MUTEX_INITIALIZER;
-
-        // Create and launch the threads
-        pthread_t* threads = (pthread_t*)arenaCalloc(build->__jobs * sizeof(pthread_t));
-        __CompileThreadArgs* args = (__CompileThreadArgs*)arenaCalloc(build->__jobs * sizeof(__CompileThreadArgs));
-
-        for (usize i = 0; i < build->__jobs; i++) {
-            build->__build_jobs.items[i].all_jobs_queued = false;
-            build->__build_jobs.items[i].all_jobs_complete = false;
-
-            // Reset queue pointers to clear any leftover objects
-            build->__build_jobs.items[i].objects.start = build->__build_jobs.items[i].objects.objects;
-            build->__build_jobs.items[i].objects.end = build->__build_jobs.items[i].objects.objects;
-
-            args[i] = (__CompileThreadArgs){
-                .build = build,
-                .includes = includes,
-                .step = step,
-                .obj_files = &object_files,
-                .obj_mutex = &obj_files_mutex,
-                .compile_cmds = &compile_commands,
-                .comp_cmd_mutex = &comp_command_mutex,
-                .job_number = i,
-            };
-
-            pthread_create(&threads[i], nullptr, __threadedCompile, &args[i]);
-        }
+        cmdPushBack(&linking_cmd, "-o");
+        cmdPushBack(&linking_cmd, output_file);
+    }
 
-        // Push all the work to the thread queues round robin
-        usize job_index = 0;
-        for (usize i = 0; i < step->objects.len; i++) {
-            Object* obj = &step->objects.items[i];
+    // Add all the object files
+    for (usize i = 0; i < state->obj_files.len; i++) {
+        cmdPushBack(&linking_cmd, state->obj_files.items[i]);
+    }
 
-            pthread_mutex_lock(&build->__build_jobs.items[job_index].mutex);
-            __objQPush(&build->__build_jobs.items[job_index].objects, obj);
-            pthread_mutex_unlock(&build->__build_jobs.items[job_index].mutex);
+    // Add all the linked object files
+    for (usize i = 0; i < step->linked_objects.len; i++) {
+        LinkedObject linked_object = step->linked_objects.items[i];
 
-            job_index = (job_index + 1) % build->__jobs;
-        }
+        Object* object = &build->__build_steps.items[linked_object.step].objects.items[linked_object.object];
 
-        // After the curretn job steps have been queued then let each thread know that
-        // there will be no more work
-        for (usize i = 0; i < build->__jobs; i++) {
-            build->__build_jobs.items[i].all_jobs_queued = true;
+        if (object->__link_path == nullptr) {
+            RLOG(LL_FATAL, "Object %s has no linked path... Object has not been compiled yet", object->src_path);
         }
 
-        // Wait for all the build jobs to finish
-        for (usize i = 0; i < build->__jobs; i++) {
-            pthread_join(threads[i], nullptr);
-        }
+        cmdPushBack(&linking_cmd, object->__link_path);
+    }
 
-        if (!build_success) {
-            RLOG(LL_FATAL, "Build failed");
+    // Link everything that is needed. ar takes no link flags, so consumers of the
+    // archive have to declare its links themselves
+    if (!archive) {
+        for (usize i = 0; i < step->links.len; i++) {
+            cmdPushBack(&linking_cmd, __linkable(&step->links.items[i]));
         }
+    }
 
-        // Run the build step linking phase
-        if (step->skip_linking == false) {
-            if (step->output_file == nullptr) {
-                RLOG(LL_FATAL, "Output file not specified");
-            }
+    // Execute the linking command
+    cmdPrint(&linking_cmd);
+    u32 link_result = cmdExec(&linking_cmd);
+    if (link_result != 0) {
+        RLOG(LL_FATAL, "Linking failed");
+    }
+}
 
-            char output_file[PATH_MAX];
-            snprintf(output_file, PATH_MAX, "%s/%s", build->__build_dir, step->output_file);
+// The whole build runs as one graph instead of step after step. Each step becomes a
+// pre-build node, one compile node per object, and a link node:
+//   - A step's compiles wait for the newest step so far with pre-build commands,
+//     which may be generating their headers, and for any buildStepDependsOn() step.
+//   - A step's pre-build commands wait for every earlier step to finish.
+//   - A step's link waits for its own compiles, the compiles of its linked objects,
+//     and the previous step's link. Earlier outputs can be linked through Links that
+//     can't be traced back to a step, so links keep their original order.
+// Steps that don't reference each other compile concurrently, and a later step's
+// compiles overlap an earlier step's link.
+void buildBuild(Build* build) {
+    __ThreadPool pool;
+    __poolStart(&pool, build->__jobs);
 
-            usize output_len = strlen(step->output_file);
-            bool archive = output_len > 2 && strcmp(step->output_file + output_len - 2, ".a") == 0;
+    __CompCmdVec compile_commands = (__CompCmdVec){0};
+    pthread_mutex_t comp_command_mutex = PTHREAD_MUTEX_INITIALIZER;
 
-            Command linking_cmd;
-            if (archive) {
-                remove(output_file); // Rebuild from scratch so members of deleted sources don't linger
-                linking_cmd = newCommand("ar", "rcs", output_file);
-            } else {
-                if (step->compiler) {
-                    linking_cmd = newCommand(step->compiler);
-                } else {
-                    linking_cmd = newCommand(build->__default_compiler);
-                }
+    usize step_count = build->__build_steps.len;
+    __StepState* states = (__StepState*)arenaCalloc(MAX(step_count, 1) * sizeof(__StepState));
+    __GraphNode** link_nodes = (__GraphNode**)arenaCalloc(MAX(step_count, 1) * sizeof(__GraphNode*));
+    __GraphNode*** compile_nodes = (__GraphNode***)arenaCalloc(MAX(step_count, 1) * sizeof(__GraphNode**));
+    __GraphNode* last_pre_node = nullptr;
+    __NodeVec nodes = (__NodeVec){0};
 
-                if (step->link_flags.len == 0) {
-                    // TODO: review
-                    // By default use the c23 standard
-                    cmdPushBack(&linking_cmd, "-std=c23");
-                } else {
-                    for (usize i = 0; i < step->link_flags.len; i++) {
-                        cmdPushBack(&linking_cmd, step->link_flags.items[i]);
-                    }
-                }
+    for (usize step_index = 0; step_index < step_count; step_index++) {
+        __BuildStep* step = &build->__build_steps.items[step_index];
+        __StepState* state = &states[step_index];
 
-                cmdPushBack(&linking_cmd, "-o");
-                cmdPushBack(&linking_cmd, output_file);
-            }
+        // Create the build step includes paths
+        __StrVec includes = (__StrVec){0};
+        for (usize i = 0; i < step->includes.len; i++) {
+            Include* inc = &step->includes.items[i];
 
-            // Add all the object files
-            for (usize i = 0; i < object_files.len; i++) {
-                cmdPushBack(&linking_cmd, object_files.items[i]);
-            }
+            VectorPushBack(char*, &includes, "-I");
+            char* inc_path = __includePath(inc, build->__symlink_dir);
+            VectorPushBack(char*, &includes, inc_path);
+        }
 
-            // Add all the linked object files
-            for (usize i = 0; i < step->linked_objects.len; i++) {
-                LinkedObject linked_object = step->linked_objects.items[i];
+        *state = (__StepState){
+            .build = build,
+            .step = step,
+            .step_index = step_index,
+            .compiler = step->compiler ? step->compiler : build->__default_compiler,
+            .includes = __joinStrings(&includes),
+            .comp_flags = __joinStrings(&step->comp_flags),
+            .obj_files = (__StrVec){0},
+            .compile_cmds = &compile_commands,
+            .comp_cmd_mutex = &comp_command_mutex,
+        };
+        pthread_mutex_init(&state->obj_mutex, nullptr);
 
-                Object* object = &build->__build_steps.items[linked_object.step].objects.items[linked_object.object];
+        __GraphNode* pre_node = nullptr;
+        if (step->pre_step_commands.len > 0) {
+            pre_node = __newNode(&nodes, &pool, __preStepJob, state);
+            if (step_index > 0) {
+                __nodeDependsOn(pre_node, link_nodes[step_index - 1]);
+            }
+            last_pre_node = pre_node;
+        }
 
-                if (object->__link_path == nullptr) {
-                    RLOG(LL_FATAL, "Object %s has no linked path... Object has not been compiled yet", object->src_path);
-                }
+        link_nodes[step_index] = __newNode(&nodes, &pool, __linkStepJob, state);
+        if (step_index > 0) {
+            __nodeDependsOn(link_nodes[step_index], link_nodes[step_index - 1]);
+        }
+        // A step with no objects would otherwise let its link (and every later step)
+        // run alongside its own pre-build commands
+        if (pre_node) {
+            __nodeDependsOn(link_nodes[step_index], pre_node);
+        }
 
-                cmdPushBack(&linking_cmd, object->__link_path);
-            }
+        compile_nodes[step_index] = (__GraphNode**)arenaCalloc(MAX(step->objects.len, 1) * sizeof(__GraphNode*));
+        __CompileJobArgs* jobs = (__CompileJobArgs*)arenaAlloc(MAX(step->objects.len, 1) * sizeof(__CompileJobArgs));
+        for (usize i = 0; i < step->objects.len; i++) {
+            jobs[i] = (__CompileJobArgs){.step = state, .obj = &step->objects.items[i]};
 
-            // Link everything that is needed. ar takes no link flags, so consumers of the
-            // archive have to declare its links themselves
-            if (!archive) {
-                for (usize i = 0; i < step->links.len; i++) {
-                    cmdPushBack(&linking_cmd, __linkable(&step->links.items[i]));
-                }
+            __GraphNode* compile_node = __newNode(&nodes, &pool, __compileJob, &jobs[i]);
+            if (last_pre_node) {
+                __nodeDependsOn(compile_node, last_pre_node);
+            }
+            for (usize d = 0; d < step->depends_on.len; d++) {
+                __nodeDependsOn(compile_node, link_nodes[step->depends_on.items[d]]);
             }
 
-            // Execute the linking command
-            cmdPrint(&linking_cmd);
-            u32 link_result = cmdExec(&linking_cmd);
-            if (link_result != 0) {
-                RLOG(LL_FATAL, "Linking failed");
+            __nodeDependsOn(link_nodes[step_index], compile_node);
+            compile_nodes[step_index][i] = compile_node;
+        }
+
+        // Linked objects always come from earlier steps, whose compile nodes exist by now
+        for (usize i = 0; i < step->linked_objects.len; i++) {
+            LinkedObject linked_object = step->linked_objects.items[i];
+            if (linked_object.step >= step_index) {
+                RLOG(LL_FATAL, "Build step %zu links an object from step %zu, which hasn't been declared yet", step_index, linked_object.step);
             }
+
+            __nodeDependsOn(link_nodes[step_index], compile_nodes[linked_object.step][linked_object.object]);
         }
     }
 
-    for (usize i = 0; i < build->__jobs; i++) {
-        pthread_mutex_destroy(&build->__build_jobs.items[i].mutex);
+    // Collect the roots before pushing any: once the first one runs, workers start
+    // releasing children themselves
+    __NodeVec roots = (__NodeVec){0};
+    for (usize i = 0; i < nodes.len; i++) {
+        if (atomic_load(&nodes.items[i]->pending_parents) == 0) {
+            VectorPushBack(__GraphNode*, &roots, nodes.items[i]);
+        }
+    }
+
+    for (usize i = 0; i < roots.len; i++) {
+        __poolPush(&pool, (__Job){.run = __runNode, .arg = roots.items[i]});
+    }
+
+    __poolWait(&pool);
+    __poolStop(&pool);
+
+    for (usize i = 0; i < step_count; i++) {
+        pthread_mutex_destroy(&states[i].obj_mutex);
     }
 
     __buildExportCompileCommands(build, &compile_commands);
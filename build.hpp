@@ -92,6 +92,10 @@ static LogLevel __global_log_level = LL_INFO;
 static bool     __log_verbose = false;
 
 void initLog(u32 buffer_size);
+// Pins text (one line, no newline) below everything logged from here on, redrawn by
+// the log thread after each batch of messages so they scroll above it instead of
+// tearing through it. NULL or "" takes it down. Only meant for a terminal on stderr.
+void __Log_status(const char* text);
 void __Log_impl(LogLevel level, const char* file, u32 line, const char* fmt, ...);
 void __Log_file_impl(const char* path, LogLevel level, const char* file, u32 line, const char* fmt, ...);
 
@@ -127,6 +131,10 @@ typedef struct {
 #else
     volatile bool running;
 #endif
+    char            status[512];
+    u32             status_len;
+    bool            status_changed;
+    bool            status_visible;
 } __RLogState;
 
 #ifndef RLOG_MAX_FILES
@@ -150,9 +158,17 @@ static void* __rlog_thread_fn(void* arg) {
     while (true) {
         pthread_mutex_lock(&s->mutex);
 
-        while (s->data_len == 0 && RUNNING_LOAD(s->running))
+        while (s->data_len == 0 && !s->status_changed && RUNNING_LOAD(s->running))
             pthread_cond_wait(&s->cond, &s->mutex);
 
+        // Carriage return and erase-line: the next write starts where the status
+        // line was, as if it had never been drawn.
+        bool redraw = s->data_len > 0 || s->status_changed;
+        if (redraw && s->status_visible) {
+            fputs("\r\033[K", stderr);
+            s->status_visible = false;
+        }
+
         while (s->data_len > 0) {
             if (s->read_pos + 4 > s->capacity) {
                 s->data_len -= s->capacity - s->read_pos;
@@ -187,6 +203,13 @@ static void* __rlog_thread_fn(void* arg) {
                 s->read_pos = 0;
         }
 
+        if (redraw && s->status_len > 0) {
+            fwrite(s->status, 1, s->status_len, stderr);
+            fflush(stderr);
+            s->status_visible = true;
+        }
+        s->status_changed = false;
+
         bool still_running = RUNNING_LOAD(s->running);
         pthread_mutex_unlock(&s->mutex);
 
@@ -201,6 +224,9 @@ static void __rlog_shutdown(void) {
     __RLogState* s = &__rlog_state;
     pthread_mutex_lock(&s->mutex);
     RUNNING_STORE(s->running, false);
+    // Don't leave a stale status line behind for the shell prompt to land on.
+    s->status_len     = 0;
+    s->status_changed = true;
     pthread_cond_signal(&s->cond);
     pthread_mutex_unlock(&s->mutex);
     pthread_join(s->thread, NULL);
@@ -241,6 +267,8 @@ void initLog(u32 buffer_size) {
     s->buf = (char*)malloc(buffer_size);
     s->capacity = buffer_size;
     s->write_pos = s->read_pos = s->data_len = 0;
+    s->status_len = 0;
+    s->status_changed = s->status_visible = false;
     pthread_mutex_init(&s->mutex, NULL);
     pthread_cond_init(&s->cond, NULL);
     RUNNING_INIT(s->running, true);
@@ -248,6 +276,19 @@ void initLog(u32 buffer_size) {
     atexit(__rlog_shutdown);
 }
 
+void __Log_status(const char* text) {
+    __RLogState* s = &__rlog_state;
+    u32 len = text != NULL ? (u32)strnlen(text, sizeof(s->status)) : 0;
+
+    pthread_mutex_lock(&s->mutex);
+    if (len > 0)
+        memcpy(s->status, text, len);
+    s->status_len = len;
+    s->status_changed = true;
+    pthread_cond_signal(&s->cond);
+    pthread_mutex_unlock(&s->mutex);
+}
+
 // Takes an already-started va_list so the std::string overload below can share this too.
 static void __Log_vimpl(LogLevel level, const char* file, u32 line, const char* fmt, va_list args) {
     if (level < __global_log_level) {
@@ -550,23 +591,45 @@ inline void __Log_file_impl(const char* path, LogLevel level, const char* file,
 
 #endif // RLOG_H
 
+#include <algorithm>
+#include <arpa/inet.h>
+#include <array>
 #include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
 #include <concepts>
+#include <csignal>
 #include <cstdio>
+#include <cstring>
+#include <ctime>
 #include <condition_variable>
 #include <cstdlib>
+#include <deque>
+#include <fcntl.h>
 #include <filesystem>
-#include <forward_list>
 #include <fstream>
 #include <functional>
 #include <initializer_list>
 #include <list>
+#include <map>
 #include <memory>
 #include <mutex>
+#include <netdb.h>
 #include <optional>
+#include <poll.h>
 #include <queue>
+#include <span>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
 #include <sys/wait.h>
 #include <thread>
 #include <tuple>
@@ -582,8 +645,90 @@ struct CommandOutput {
         i32         exit_code;
         std::string stdout_output;
         std::string stderr_output;
+        // From wait4()'s rusage, so they cover the whole subprocess tree the shell
+        // waited on (i.e. the compiler itself), not just the shell. Zero for anything
+        // that didn't actually spawn a process.
+        f64         wall_seconds   = 0.0;
+        f64         cpu_seconds    = 0.0;
+        u64         peak_rss_bytes = 0;
+};
+
+// Every subprocess Command::exec() has running right now, so a cancelled build (see
+// Build::watchSignals) can terminate them rather than leave compilers orphaned. Each
+// child leads its own process group and the whole group is signalled — "sh -c" plus
+// whatever compiler, assembler or linker it started underneath.
+class __ChildProcesses {
+    private:
+        std::mutex                mutex_;
+        std::unordered_set<pid_t> pids_;
+        bool                      cancelled_ = false;
+
+    public:
+        static __ChildProcesses& instance() {
+            static __ChildProcesses children;
+            return children;
+        }
+
+        // fork()s under the lock, so cancel() can't slip in between a fork and its pid
+        // being recorded. Once cancelled, doesn't fork at all and returns -1.
+        template <typename F>
+        pid_t spawn(F&& child) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (cancelled_) {
+                return -1;
+            }
+
+            pid_t pid = fork();
+            if (pid == 0) {
+                child();
+            }
+            if (pid > 0) {
+                // Also set from the parent: whichever side runs first, the group exists
+                // before cancel() could ever target it.
+                setpgid(pid, pid);
+                pids_.insert(pid);
+            }
+            return pid;
+        }
+
+        void reaped(pid_t pid) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            pids_.erase(pid);
+        }
+
+        void cancel() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            cancelled_ = true;
+            for (pid_t pid : pids_) {
+                kill(-pid, SIGTERM);
+            }
+        }
+
+        bool cancelled() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return cancelled_;
+        }
 };
 
+// Close-on-exec from the start, not fcntl()'d after: under -j other threads fork
+// children concurrently, and any fd that isn't CLOEXEC yet when they do leaks into
+// them. A leaked pipe write end held by a child that outlives its job keeps
+// another job's read() from ever seeing EOF.
+inline bool __cloexecPipe(i32 fds[2]) {
+#if defined(__APPLE__)
+    // No pipe2() on macOS — the window is still there, but only the fork()s racing
+    // these two fcntl()s can see it.
+    if (pipe(fds) != 0) {
+        return false;
+    }
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+    return true;
+#else
+    return pipe2(fds, O_CLOEXEC) == 0;
+#endif
+}
+
 class Command {
     private:
         std::vector<std::string>             command_chain_;
@@ -596,6 +741,7 @@ class Command {
     public:
         Command() = default;
         Command(std::initializer_list<std::string> command_chain) : command_chain_(command_chain) {}
+        explicit Command(std::vector<std::string> command_chain) : command_chain_(std::move(command_chain)) {}
 
         template <typename T>
         void push_back(T&& arg) { command_chain_.emplace_back(std::forward<T>(arg)); }
@@ -633,27 +779,77 @@ class Command {
             return result;
         }
 
+        // fork()+exec of "sh -c", not popen(): pclose() throws away the child's
+        // rusage, and wait4() is the only way to get peak RSS and CPU time for it.
+        // Between fork() and exec the child only touches async-signal-safe calls —
+        // every other thread's locks are frozen mid-state in it.
         CommandOutput exec() const {
             std::filesystem::path stderr_path = std::filesystem::temp_directory_path() / "buildcpp_stderr_XXXXXX";
             std::string           stderr_template = stderr_path.string();
 
-            i32 stderr_fd = mkstemp(stderr_template.data());
-            close(stderr_fd);
+            // CLOEXEC for the same reason as the pipe (see __cloexecPipe); dup2() onto
+            // stderr in the child clears it again there.
+            i32 stderr_fd = mkostemp(stderr_template.data(), O_CLOEXEC);
 
-            std::string command = string() + " 2>" + stderr_template;
+            std::string command = string();
             if (exec_dir_.has_value()) {
                 command = "cd " + exec_dir_->string() + " && " + command;
             }
 
-            FILE* pipe = popen(command.c_str(), "r");
+            i32 stdout_pipe[2];
+            if (!__cloexecPipe(stdout_pipe)) {
+                close(stderr_fd);
+                std::filesystem::remove(stderr_template);
+                return CommandOutput{-1, "", "Failed to create pipe"};
+            }
+
+            auto  start = std::chrono::steady_clock::now();
+            pid_t pid   = __ChildProcesses::instance().spawn([&] {
+                setpgid(0, 0);
+                dup2(stdout_pipe[1], STDOUT_FILENO);
+                dup2(stderr_fd, STDERR_FILENO);
+                close(stdout_pipe[0]);
+                close(stdout_pipe[1]);
+                close(stderr_fd);
+                execl("/bin/sh", "sh", "-c", command.c_str(), static_cast<char*>(nullptr));
+                _exit(127);
+            });
+
+            close(stdout_pipe[1]);
+            close(stderr_fd);
 
             CommandOutput output;
-            char          buffer[256];
-            while (fgets(buffer, sizeof(buffer), pipe) != nullptr) {
-                output.stdout_output += buffer;
+            char          buffer[4096];
+            isize         count;
+            while ((count = read(stdout_pipe[0], buffer, sizeof(buffer))) != 0) {
+                if (count < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    break;
+                }
+                output.stdout_output.append(buffer, static_cast<usize>(count));
+            }
+            close(stdout_pipe[0]);
+
+            i32           status = 0;
+            struct rusage usage  = {};
+            if (pid < 0) {
+                status = 127 << 8;
+            } else {
+                while (wait4(pid, &status, 0, &usage) < 0 && errno == EINTR) {
+                }
+                __ChildProcesses::instance().reaped(pid);
             }
 
-            i32 result = pclose(pipe);
+            output.wall_seconds = std::chrono::duration<f64>(std::chrono::steady_clock::now() - start).count();
+            output.cpu_seconds  = static_cast<f64>(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec)
+                               + static_cast<f64>(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+#if defined(__APPLE__)
+            output.peak_rss_bytes = static_cast<u64>(usage.ru_maxrss);
+#else
+            output.peak_rss_bytes = static_cast<u64>(usage.ru_maxrss) * 1024;
+#endif
 
             std::ifstream     stderr_file(stderr_template);
             std::stringstream stderr_stream;
@@ -662,7 +858,9 @@ class Command {
 
             std::filesystem::remove(stderr_template);
 
-            output.exit_code = WEXITSTATUS(result);
+            // A signal-killed compiler is a failure too, not the 0 WEXITSTATUS would
+            // read out of it — shell convention, 128 + signal number.
+            output.exit_code = WIFSIGNALED(status) ? 128 + WTERMSIG(status) : WEXITSTATUS(status);
             return output;
         }
 
@@ -753,12 +951,357 @@ concept __IsInclude = std::same_as<T, __IncludeDirect> || std::same_as<T, __Incl
 
 using __IncludeVariant = std::variant<__IncludeDirect, __IncludeSymbolic>;
 
+// Length-prefixed frames for the remote-compile protocol (RemoteExecutor here,
+// worker.cpp on the other end): a u32 length in network byte order, then that many
+// bytes. Both directions loop over short reads/writes — a socket hands back
+// whatever it has, not whole messages.
+#if defined(MSG_NOSIGNAL)
+inline constexpr i32 __SEND_FLAGS = MSG_NOSIGNAL;
+#else
+inline constexpr i32 __SEND_FLAGS = 0;
+#endif
+
+inline bool __sendAll(i32 fd, const char* data, usize size) {
+    while (size > 0) {
+        isize sent = send(fd, data, size, __SEND_FLAGS);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            return false;
+        }
+        data += sent;
+        size -= static_cast<usize>(sent);
+    }
+    return true;
+}
+
+inline bool __recvAll(i32 fd, char* data, usize size) {
+    while (size > 0) {
+        isize received = recv(fd, data, size, 0);
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received <= 0) {
+            return false;
+        }
+        data += received;
+        size -= static_cast<usize>(received);
+    }
+    return true;
+}
+
+inline bool __sendFrame(i32 fd, const std::string& frame) {
+    u32 length = htonl(static_cast<u32>(frame.size()));
+    return __sendAll(fd, reinterpret_cast<const char*>(&length), sizeof(length)) && __sendAll(fd, frame.data(), frame.size());
+}
+
+// Frames over max_length (1 GiB unless the caller expects something smaller) are
+// taken as a protocol error, not allocated.
+inline bool __recvFrame(i32 fd, std::string& frame, u32 max_length = 1u << 30) {
+    u32 length = 0;
+    if (!__recvAll(fd, reinterpret_cast<char*>(&length), sizeof(length))) {
+        return false;
+    }
+
+    length = ntohl(length);
+    if (length > max_length) {
+        return false;
+    }
+
+    frame.resize(length);
+    return __recvAll(fd, frame.data(), length);
+}
+
+// Any send() or recv() on fd that makes no progress for this long fails with
+// EAGAIN instead of blocking forever — which __sendAll/__recvAll treat like any
+// other transport error.
+inline void __setSocketTimeouts(i32 fd, i32 seconds) {
+    timeval timeout = {};
+    timeout.tv_sec  = seconds;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+}
+
+// connect() bounded by timeout_ms: non-blocking, then poll() for writability. A
+// host dropping packets otherwise holds connect() for the kernel's SYN retries,
+// minutes on Linux. The socket is left blocking again either way.
+inline bool __connectWithin(i32 fd, const sockaddr* address, socklen_t length, i32 timeout_ms) {
+    i32 flags = fcntl(fd, F_GETFL);
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+
+    bool connected = connect(fd, address, length) == 0;
+    if (!connected && (errno == EINPROGRESS || errno == EINTR)) {
+        pollfd waiting = {fd, POLLOUT, 0};
+        i32    ready;
+        while ((ready = poll(&waiting, 1, timeout_ms)) < 0 && errno == EINTR) {
+        }
+
+        i32       error        = 0;
+        socklen_t error_length = sizeof(error);
+        connected              = ready > 0 && getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &error_length) == 0 && error == 0;
+    }
+
+    fcntl(fd, F_SETFL, flags);
+    return connected;
+}
+
+// "unix:/path/to/socket" or "host:port". Returns the socket, or -1. timeout_ms
+// bounds each connect() attempt; 0 leaves them blocking.
+inline i32 __openEndpoint(const std::string& endpoint, bool listening, i32 timeout_ms = 0) {
+    if (endpoint.starts_with("unix:")) {
+        std::string path = endpoint.substr(5);
+        sockaddr_un address = {};
+        if (path.size() >= sizeof(address.sun_path)) {
+            return -1;
+        }
+        address.sun_family = AF_UNIX;
+        memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+        i32 fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) {
+            return -1;
+        }
+        if (listening) {
+            unlink(path.c_str());
+        }
+        bool opened = listening ? bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0 && listen(fd, 64) == 0
+                    : timeout_ms > 0 ? __connectWithin(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address), timeout_ms)
+                                     : connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0;
+        if (!opened) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    usize colon = endpoint.rfind(':');
+    if (colon == std::string::npos) {
+        return -1;
+    }
+    std::string host = endpoint.substr(0, colon);
+    std::string port = endpoint.substr(colon + 1);
+
+    addrinfo hints = {};
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags    = listening ? AI_PASSIVE : 0;
+
+    addrinfo* results = nullptr;
+    if (getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &results) != 0) {
+        return -1;
+    }
+
+    i32 fd = -1;
+    for (addrinfo* info = results; info != nullptr; info = info->ai_next) {
+        fd = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+
+        i32 yes = 1;
+#if defined(SO_NOSIGPIPE)
+        setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &yes, sizeof(yes));
+#endif
+        if (listening) {
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+            if (bind(fd, info->ai_addr, info->ai_addrlen) == 0 && listen(fd, 64) == 0) {
+                break;
+            }
+        } else if (timeout_ms > 0 ? __connectWithin(fd, info->ai_addr, info->ai_addrlen, timeout_ms) : connect(fd, info->ai_addr, info->ai_addrlen) == 0) {
+            break;
+        }
+
+        close(fd);
+        fd = -1;
+    }
+
+    freeaddrinfo(results);
+    return fd;
+}
+
+inline constexpr const char* __REMOTE_PROTOCOL = "BCR1";
+
+// Ships Object compiles to worker daemons (worker.cpp) and falls back to compiling
+// locally when none can be reached. The TU is preprocessed here first, so a worker
+// needs nothing but the same compiler — no checkout, no headers, no include paths.
+// One connection per compile: request is the protocol tag, compiler, preprocessed
+// file extension, source name, flag count, the flags, then the preprocessed source;
+// reply is the tag, "exit_code cpu_seconds peak_rss_bytes", stderr, and the object.
+class RemoteExecutor {
+    private:
+        // A worker that can't even accept a connection this fast is treated as down.
+        static constexpr i32 CONNECT_TIMEOUT_MS = 3000;
+        // Per send()/recv(), so it has to outlast the longest compile: a worker sends
+        // nothing back while it's compiling. What it catches is a worker that stalls
+        // or vanishes, which would otherwise hold this build slot forever.
+        static constexpr i32 IO_TIMEOUT_SECONDS = 600;
+
+        struct Endpoint {
+                std::string       address;
+                // Set on the first failure to reach it (a timeout included) — not
+                // retried for the rest of the build, so a dead worker costs one
+                // timeout, not one per TU.
+                std::atomic<bool> down = false;
+        };
+
+        // deque: Endpoint holds an atomic, so it can't be moved by a vector regrowth.
+        std::deque<Endpoint> endpoints_;
+        std::atomic<usize>   next_ = 0;
+
+        // Whatever suffix makes the worker's compiler treat the file as already
+        // preprocessed, without having to pass -x.
+        static std::string preprocessedExtension(const std::filesystem::path& source) {
+            std::string extension = source.extension().string();
+            if (extension == ".c") {
+                return ".i";
+            }
+            if (extension == ".m") {
+                return ".mi";
+            }
+            if (extension == ".mm") {
+                return ".mii";
+            }
+            return ".ii";
+        }
+
+        // nullopt on any transport or protocol failure — the caller moves on to the
+        // next worker. A compile error is not a failure here: it comes back as a
+        // CommandOutput with the worker's exit code and diagnostics.
+        std::optional<CommandOutput> request(
+            Endpoint& endpoint, const std::string& compiler, const std::vector<std::string>& compile_flags, const std::filesystem::path& source,
+            const std::string& preprocessed, const std::filesystem::path& output
+        ) {
+            i32 fd = __openEndpoint(endpoint.address, false, CONNECT_TIMEOUT_MS);
+            if (fd < 0) {
+                return std::nullopt;
+            }
+            __setSocketTimeouts(fd, IO_TIMEOUT_SECONDS);
+
+            bool sent = __sendFrame(fd, __REMOTE_PROTOCOL) && __sendFrame(fd, compiler) && __sendFrame(fd, preprocessedExtension(source))
+                     && __sendFrame(fd, source.filename().string()) && __sendFrame(fd, std::to_string(compile_flags.size()));
+            for (usize i = 0; sent && i < compile_flags.size(); ++i) {
+                sent = __sendFrame(fd, compile_flags[i]);
+            }
+            sent = sent && __sendFrame(fd, preprocessed);
+
+            std::string tag, status, stderr_output, object;
+            bool        received = sent && __recvFrame(fd, tag) && tag == __REMOTE_PROTOCOL && __recvFrame(fd, status) && __recvFrame(fd, stderr_output)
+                          && __recvFrame(fd, object);
+            close(fd);
+
+            if (!received) {
+                return std::nullopt;
+            }
+
+            CommandOutput result{-1, "", std::move(stderr_output)};
+            std::istringstream(status) >> result.exit_code >> result.cpu_seconds >> result.peak_rss_bytes;
+            if (result.exit_code != 0) {
+                return result;
+            }
+
+            // Renamed into place, so a build interrupted mid-write never leaves a
+            // truncated object looking up to date. A failed write doesn't leave its
+            // partial file behind either — the local fallback writes the real one.
+            std::filesystem::path partial = output;
+            partial += ".remote";
+            std::error_code error;
+            {
+                std::ofstream file(partial, std::ios::binary | std::ios::trunc);
+                file.write(object.data(), static_cast<std::streamsize>(object.size()));
+                file.close();
+                if (!file) {
+                    std::filesystem::remove(partial, error);
+                    return std::nullopt;
+                }
+            }
+            std::filesystem::rename(partial, output, error);
+            if (error) {
+                std::filesystem::remove(partial, error);
+                return std::nullopt;
+            }
+            return result;
+        }
+
+    public:
+        void addWorker(const std::string& address) { endpoints_.emplace_back().address = address; }
+
+        bool enabled() const { return !endpoints_.empty(); }
+
+        // preprocess is the local "-E" run whose stdout is the TU to ship. Its own
+        // failure (a missing header, say) is the compile's failure, reported as-is.
+        // nullopt means no worker could take it and the caller should compile locally.
+        std::optional<CommandOutput> compile(
+            const Command& preprocess, const std::string& compiler, const std::vector<std::string>& compile_flags, const std::filesystem::path& source,
+            const std::filesystem::path& output
+        ) {
+            auto          start        = std::chrono::steady_clock::now();
+            CommandOutput preprocessed = preprocess.exec();
+            if (preprocessed.exit_code != 0) {
+                return preprocessed;
+            }
+
+            usize count = endpoints_.size();
+            usize first = next_.fetch_add(1);
+            for (usize i = 0; i < count; ++i) {
+                Endpoint& endpoint = endpoints_[(first + i) % count];
+                if (endpoint.down.load()) {
+                    continue;
+                }
+
+                std::optional<CommandOutput> result = request(endpoint, compiler, compile_flags, source, preprocessed.stdout_output, output);
+                if (result.has_value()) {
+                    result->wall_seconds = std::chrono::duration<f64>(std::chrono::steady_clock::now() - start).count();
+                    return result;
+                }
+
+                if (!endpoint.down.exchange(true)) {
+                    RLOG(LL_WARN, "Remote worker " + endpoint.address + " unavailable — not using it for the rest of this build");
+                }
+            }
+
+            return std::nullopt;
+        }
+};
+
 struct CompileCommandEntry {
         std::filesystem::path directory;
         std::string           command;
         std::filesystem::path file;
 };
 
+// A BuildGroup's compile configuration, resolved once per dispatch (see
+// BuildGroup::freeze) rather than by every task. argv is how each of the group's
+// compiles starts — compiler, flags, then one -I per include dir — already rendered, so
+// a task only appends its own file's arguments.
+struct __CompileConfig {
+        std::string              compiler;
+        // Also kept apart from argv for RemoteExecutor: a worker gets the flags without
+        // the -I's, since the TU it's sent is already preprocessed.
+        std::vector<std::string> flags;
+        std::vector<std::string> argv;
+        // --time-trace. Appended by Object::compile() alone, never to argv: the -MM
+        // scan, the signature and the DAG manifest key would all change with it.
+        bool                     time_trace = false;
+};
+
+// Same for linking: argv is the compiler and the link flags, linkables the group's
+// rendered Links (-lfoo/-L.../-framework Foo).
+struct __LinkConfig {
+        std::vector<std::string> argv;
+        std::vector<std::string> linkables;
+};
+
+// FNV-1a — for change detection against our own earlier output only, never anything
+// shared, so nothing stronger is needed.
+inline u64 __fnv1a(std::string_view data, u64 hash = 14695981039346656037ull) {
+    for (char c : data) {
+        hash ^= static_cast<u8>(c);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
 class Object {
     private:
         std::filesystem::path source_path_;
@@ -775,35 +1318,45 @@ class Object {
             return path;
         }
 
-        CommandOutput compile(const std::string& compiler, const std::filesystem::path& build_dir, const std::vector<std::filesystem::path>& include_paths, const std::vector<std::string>& compile_flags) {
+        // remote, when set, gets first go at it (see RemoteExecutor); a local compile
+        // is the fallback when no worker can take it.
+        CommandOutput compile(const __CompileConfig& config, const std::filesystem::path& build_dir, RemoteExecutor* remote = nullptr) {
             output_path_ = outputPath(build_dir);
 
             std::filesystem::create_directories(output_path_.parent_path());
 
-            return compileCommand(compiler, build_dir, include_paths, compile_flags).exec();
+            if (remote != nullptr) {
+                Command preprocess(config.argv);
+                preprocess.push_back("-E");
+                preprocess.push_back(source_path_.string());
+
+                if (auto result = remote->compile(preprocess, config.compiler, config.flags, source_path_, output_path_)) {
+                    return *result;
+                }
+            }
+
+            Command cmd = compileCommand(config, build_dir);
+            if (config.time_trace) {
+                cmd.push_back("-ftime-trace");
+            }
+            return cmd.exec();
         }
 
         // What compile() would run, without running it — shared so compile_commands.json
         // generation and the real compile can never drift apart.
-        CompileCommandEntry compileCommandEntry(const std::string& compiler, const std::filesystem::path& build_dir, const std::vector<std::filesystem::path>& include_paths, const std::vector<std::string>& compile_flags) const {
+        CompileCommandEntry compileCommandEntry(const __CompileConfig& config, const std::filesystem::path& build_dir) const {
             return CompileCommandEntry{
                 std::filesystem::current_path(),
-                compileCommand(compiler, build_dir, include_paths, compile_flags).string(),
+                compileCommand(config, build_dir).string(),
                 std::filesystem::absolute(source_path_),
             };
         }
 
-        // compile_flags are included here too (not just compile()): a -D flag can gate
-        // an #include behind a macro, so dependency discovery run without the same
+        // The group's flags are included here too (not just compile()): a -D flag can
+        // gate an #include behind a macro, so dependency discovery run without the same
         // flags as the real compile could silently diverge from it.
-        std::vector<std::filesystem::path> listDependencies(const std::string& compiler, const std::vector<std::filesystem::path>& include_paths, const std::vector<std::string>& compile_flags) {
-            Command cmd({compiler});
-            for (const auto& flag : compile_flags) {
-                cmd.push_back(flag);
-            }
-            for (const auto& include_path : include_paths) {
-                cmd.push_back("-I" + include_path.string());
-            }
+        std::vector<std::filesystem::path> listDependencies(const __CompileConfig& config) {
+            Command cmd(config.argv);
             cmd.push_back("-MM");
             cmd.push_back(source_path_.string());
 
@@ -826,14 +1379,8 @@ class Object {
         }
 
     private:
-        Command compileCommand(const std::string& compiler, const std::filesystem::path& build_dir, const std::vector<std::filesystem::path>& include_paths, const std::vector<std::string>& compile_flags) const {
-            Command cmd({compiler});
-            for (const auto& flag : compile_flags) {
-                cmd.push_back(flag);
-            }
-            for (const auto& include_path : include_paths) {
-                cmd.push_back("-I" + include_path.string());
-            }
+        Command compileCommand(const __CompileConfig& config, const std::filesystem::path& build_dir) const {
+            Command cmd(config.argv);
             cmd.push_back("-c");
             cmd.push_back(source_path_.string());
             cmd.push_back("-o");
@@ -929,37 +1476,90 @@ using __LinkVariant = std::variant<__LinkDependency, __LinkPath, __LinkFramework
 using __LinkVariant = std::variant<__LinkDependency, __LinkPath>;
 #endif
 
+// ThinLTO for a Binary or Library link. Every Object feeding that link is compiled
+// with -flto=thin too (see Build::markLtoObjects) — bitcode is what makes the link
+// step an LTO one at all. Each policy field left unset keeps the linker's own default.
+struct ThinLto {
+        std::optional<u32> prune_interval_seconds;
+        std::optional<u32> prune_after_seconds;
+        std::optional<u32> max_cache_size_percent;
+};
+
+// The ThinLTO cache is keyed by module hash, so a relink after a one-file change only
+// re-optimizes the modules that actually changed (or import from one that did). It
+// lives under build_dir, one per output, so cleaning the build dir cleans it too.
+inline std::vector<std::string> __thinLtoLinkFlags(const ThinLto& lto, const std::filesystem::path& cache_dir, i32 jobs) {
+    std::vector<std::string> flags = {"-flto=thin", "-flto-jobs=" + std::to_string(jobs)};
+
+#if defined(__APPLE__)
+    flags.push_back("-Wl,-cache_path_lto," + cache_dir.string());
+    if (lto.prune_interval_seconds.has_value()) {
+        flags.push_back("-Wl,-prune_interval_lto," + std::to_string(*lto.prune_interval_seconds));
+    }
+    if (lto.prune_after_seconds.has_value()) {
+        flags.push_back("-Wl,-prune_after_lto," + std::to_string(*lto.prune_after_seconds));
+    }
+    if (lto.max_cache_size_percent.has_value()) {
+        flags.push_back("-Wl,-max_relative_cache_size_lto," + std::to_string(*lto.max_cache_size_percent));
+    }
+#else
+    // Only lld understands --thinlto-cache-dir; the GNU linkers' plugin doesn't.
+    flags.push_back("-fuse-ld=lld");
+    flags.push_back("-Wl,--thinlto-cache-dir=" + cache_dir.string());
+
+    std::string policy;
+    if (lto.prune_interval_seconds.has_value()) {
+        policy += ":prune_interval=" + std::to_string(*lto.prune_interval_seconds) + "s";
+    }
+    if (lto.prune_after_seconds.has_value()) {
+        policy += ":prune_after=" + std::to_string(*lto.prune_after_seconds) + "s";
+    }
+    if (lto.max_cache_size_percent.has_value()) {
+        policy += ":cache_size=" + std::to_string(*lto.max_cache_size_percent) + "%";
+    }
+    if (!policy.empty()) {
+        flags.push_back("-Wl,--thinlto-cache-policy=" + policy.substr(1));
+    }
+#endif
+
+    return flags;
+}
+
 // Only holds a name, not a path: the actual location (<build_dir>/bin/<name>) isn't
 // known until build_dir shows up at execute() time, same as Object's source vs. output
 // path split.
 class Binary {
     private:
-        std::filesystem::path name_;
+        std::filesystem::path  name_;
+        std::optional<ThinLto> lto_;
 
     public:
         Binary(const std::filesystem::path& name) : name_(name) {}
+        Binary(const std::filesystem::path& name, ThinLto lto) : name_(name), lto_(lto) {}
 
         const std::filesystem::path& name() const { return name_; }
 
+        const std::optional<ThinLto>& lto() const { return lto_; }
+
         std::filesystem::path path(const std::filesystem::path& build_dir) const { return build_dir / "bin" / name_; }
 
         // linkables (-lfoo/-L.../-framework Foo) go after the object files that need
-        // their symbols, matching normal linker convention.
-        CommandOutput link(
-            const std::string& compiler, const std::filesystem::path& build_dir, const std::vector<std::filesystem::path>& object_files,
-            const std::vector<std::string>& link_flags, const std::vector<std::string>& linkables
-        ) {
+        // their symbols, matching normal linker convention. jobs is only used for
+        // ThinLTO's backend parallelism, sized to match the thread pool.
+        CommandOutput link(const __LinkConfig& config, const std::filesystem::path& build_dir, const std::vector<std::filesystem::path>& object_files, i32 jobs) {
             std::filesystem::path output_path = path(build_dir);
             std::filesystem::create_directories(output_path.parent_path());
 
-            Command cmd({compiler});
-            for (const auto& flag : link_flags) {
-                cmd.push_back(flag);
+            Command cmd(config.argv);
+            if (lto_.has_value()) {
+                for (auto& flag : __thinLtoLinkFlags(*lto_, build_dir / "thinlto-cache" / name_, jobs)) {
+                    cmd.push_back(std::move(flag));
+                }
             }
             for (const auto& obj : object_files) {
                 cmd.push_back(obj.string());
             }
-            for (const auto& linkable : linkables) {
+            for (const auto& linkable : config.linkables) {
                 cmd.push_back(linkable);
             }
             cmd.push_back("-o");
@@ -971,18 +1571,39 @@ class Binary {
 
 enum class Linkage { Shared, Static };
 
+// Only consulted for Linkage::Static. Full is the original delete-and-rearchive
+// behavior. Thin (ar's T modifier) stores member paths instead of copying object
+// bytes, so even a full rewrite is just a path list plus symbol index — the only
+// mode whose relinks don't cost the archive's whole size in I/O. Incremental keeps
+// a normal archive and hands ar only the changed members, but ar still writes the
+// whole archive out again to replace them; it saves the unchanged objects' reads,
+// not the rewrite.
+enum class ArchiveMode { Full, Thin, Incremental };
+
 class Library {
     private:
         std::filesystem::path name_;
         Linkage                linkage_;
+        ArchiveMode            archive_mode_;
+        std::optional<ThinLto> lto_;
 
     public:
-        Library(const std::filesystem::path& name, Linkage linkage) : name_(name), linkage_(linkage) {}
+        Library(const std::filesystem::path& name, Linkage linkage, ArchiveMode archive_mode = ArchiveMode::Full)
+            : name_(name), linkage_(linkage), archive_mode_(archive_mode) {}
+
+        // For a static library only the members' -flto=thin matters — the archive just
+        // carries their bitcode through to whichever final link pulls it in.
+        Library(const std::filesystem::path& name, Linkage linkage, ThinLto lto, ArchiveMode archive_mode = ArchiveMode::Full)
+            : name_(name), linkage_(linkage), archive_mode_(archive_mode), lto_(lto) {}
 
         const std::filesystem::path& name() const { return name_; }
 
         Linkage linkage() const { return linkage_; }
 
+        ArchiveMode archiveMode() const { return archive_mode_; }
+
+        const std::optional<ThinLto>& lto() const { return lto_; }
+
         std::filesystem::path path(const std::filesystem::path& build_dir) const {
             std::filesystem::path filename = "lib" + name_.string();
 #if defined(__APPLE__)
@@ -993,28 +1614,34 @@ class Library {
             return build_dir / "lib" / filename;
         }
 
-        // link_flags/linkables only apply to the shared-library path — ar (static
-        // archiving) has no notion of compiler/linker flags or external libraries.
-        CommandOutput link(
-            const std::string& compiler, const std::filesystem::path& build_dir, const std::vector<std::filesystem::path>& object_files,
-            const std::vector<std::string>& link_flags, const std::vector<std::string>& linkables
-        ) {
+        // config only applies to the shared-library path — ar (static archiving) has
+        // no notion of compiler/linker flags or external libraries.
+        CommandOutput link(const __LinkConfig& config, const std::filesystem::path& build_dir, const std::vector<std::filesystem::path>& object_files, i32 jobs) {
             std::filesystem::path output_path = path(build_dir);
             std::filesystem::create_directories(output_path.parent_path());
 
             if (linkage_ == Linkage::Static) {
-                std::filesystem::remove(output_path);
-
-                Command cmd({"ar", "rcs", output_path.string()});
-                for (const auto& obj : object_files) {
-                    cmd.push_back(obj.string());
+                switch (archive_mode_) {
+                    case ArchiveMode::Thin:
+#if defined(__APPLE__)
+                        // Apple's ar/libtool have no thin archives at all.
+                        RLOG(LL_WARN, "Thin archives aren't supported on macOS, writing a full archive: " + output_path.string());
+                        return rebuildArchive(output_path, object_files, false);
+#else
+                        return rebuildArchive(output_path, object_files, true);
+#endif
+                    case ArchiveMode::Incremental:
+                        return updateArchive(output_path, object_files);
+                    default:
+                        return rebuildArchive(output_path, object_files, false);
                 }
-                return cmd.exec();
             }
 
-            Command cmd({compiler});
-            for (const auto& flag : link_flags) {
-                cmd.push_back(flag);
+            Command cmd(config.argv);
+            if (lto_.has_value()) {
+                for (auto& flag : __thinLtoLinkFlags(*lto_, build_dir / "thinlto-cache" / name_, jobs)) {
+                    cmd.push_back(std::move(flag));
+                }
             }
 #if defined(__APPLE__)
             cmd.push_back("-dynamiclib");
@@ -1024,7 +1651,7 @@ class Library {
             for (const auto& obj : object_files) {
                 cmd.push_back(obj.string());
             }
-            for (const auto& linkable : linkables) {
+            for (const auto& linkable : config.linkables) {
                 cmd.push_back(linkable);
             }
             cmd.push_back("-o");
@@ -1032,10 +1659,101 @@ class Library {
 
             return cmd.exec();
         }
+
+    private:
+        // From scratch, so members of deleted sources don't linger. Cheap for a thin
+        // archive — nothing but paths and the symbol index gets written.
+        CommandOutput rebuildArchive(const std::filesystem::path& output_path, const std::vector<std::filesystem::path>& object_files, bool thin) const {
+            std::filesystem::remove(output_path);
+
+            Command cmd({"ar", thin ? "rcsT" : "rcs", output_path.string()});
+            for (const auto& obj : object_files) {
+                cmd.push_back(obj.string());
+            }
+            return cmd.exec();
+        }
+
+        // ar addresses members by bare filename, so this only works while every
+        // object's filename is unique — two components each owning a flash.o can't be
+        // told apart by "ar r", and fall back to a full rebuild instead. So does a
+        // dropped member: ar can't delete and replace in one call, and a separate
+        // "ar d" would write the whole archive out a second time.
+        CommandOutput updateArchive(const std::filesystem::path& output_path, const std::vector<std::filesystem::path>& object_files) const {
+            if (!std::filesystem::exists(output_path)) {
+                return rebuildArchive(output_path, object_files, false);
+            }
+
+            std::unordered_set<std::string> wanted;
+            for (const auto& obj : object_files) {
+                if (!wanted.insert(obj.filename().string()).second) {
+                    RLOG(LL_DEBUG, "Duplicate member name " + obj.filename().string() + ", rebuilding " + output_path.string());
+                    return rebuildArchive(output_path, object_files, false);
+                }
+            }
+
+            CommandOutput listing = Command({"ar", "t", output_path.string()}).exec();
+            if (listing.exit_code != 0) {
+                return rebuildArchive(output_path, object_files, false);
+            }
+
+            std::unordered_set<std::string> members;
+            std::istringstream              iss(listing.stdout_output);
+            std::string                     member;
+            while (std::getline(iss, member)) {
+                if (!member.empty()) {
+                    members.insert(member);
+                }
+            }
+
+            std::filesystem::file_time_type archive_time = std::filesystem::last_write_time(output_path);
+
+            for (const auto& name : members) {
+                if (!wanted.contains(name)) {
+                    RLOG(LL_DEBUG, "Member " + name + " no longer wanted, rebuilding " + output_path.string());
+                    return rebuildArchive(output_path, object_files, false);
+                }
+            }
+
+            Command replaced({"ar", "rcs", output_path.string()});
+            bool    any_replaced = false;
+            for (const auto& obj : object_files) {
+                if (!members.contains(obj.filename().string()) || std::filesystem::last_write_time(obj) > archive_time) {
+                    replaced.push_back(obj.string());
+                    any_replaced = true;
+                }
+            }
+
+            if (any_replaced) {
+                return replaced.exec();
+            }
+
+            // Nothing to write, but the archive still has to end up newer than its
+            // objects, or isStale() would flag it again on every run.
+            std::filesystem::last_write_time(output_path, std::filesystem::file_time_type::clock::now());
+            return CommandOutput{0, "", ""};
+        }
 };
 
 class Build;
 
+// Output's variant index, as something that can be stored and printed — build
+// history records and reports group by it.
+enum class TaskKind : u8 { Object, Binary, Library, Command };
+
+inline const char* __taskKindName(TaskKind kind) {
+    switch (kind) {
+        case TaskKind::Object:
+            return "Object";
+        case TaskKind::Binary:
+            return "Binary";
+        case TaskKind::Library:
+            return "Library";
+        case TaskKind::Command:
+            return "Command";
+    }
+    return "Unknown";
+}
+
 // Wraps whatever a task ultimately produces: a compiled Object, a linked Binary/
 // Library, or a bare Command (a pre/post-build step with no compile or link semantics
 // of its own — see Output::assignCommandName).
@@ -1049,44 +1767,42 @@ class Output {
         Output(Library library) : value_(std::move(library)) {}
         Output(Command command) : value_(std::move(command)) {}
 
-        // Sorts by variant: Object gets compile_flags; Binary/Library get link_flags and
-        // linkables (-lfoo/-L.../-framework Foo); Command just runs — none of the
-        // compile/link machinery applies to it.
+        // Sorts by variant: Object gets the compile config; Binary/Library get the link
+        // config; Command just runs — none of the compile/link machinery applies to it.
         CommandOutput execute(
-            const std::string&                         compiler,
-            const std::filesystem::path&                build_dir,
-            const std::vector<std::filesystem::path>&   include_paths,
-            const std::vector<std::filesystem::path>&   object_files,
-            const std::vector<std::string>&              compile_flags,
-            const std::vector<std::string>&              link_flags,
-            const std::vector<std::string>&              linkables
+            const __CompileConfig&                    compile,
+            const __LinkConfig&                       link,
+            const std::filesystem::path&              build_dir,
+            const std::vector<std::filesystem::path>& object_files,
+            i32                                       jobs,
+            RemoteExecutor*                           remote
         ) {
             return std::visit(
                 [&](auto& out) -> CommandOutput {
                     using T = std::decay_t<decltype(out)>;
 
                     if constexpr (std::same_as<T, Object>) {
-                        RLOG(LL_INFO, "Compiling: " + out.sourcePath().string());
-                        return out.compile(compiler, build_dir, include_paths, compile_flags);
+                        RLOG(LL_INFO, (remote != nullptr ? "Compiling (remote): " : "Compiling: ") + out.sourcePath().string());
+                        return out.compile(compile, build_dir, remote);
                     } else if constexpr (std::same_as<T, Command>) {
                         RLOG(LL_INFO, "Running command: " + out.string());
                         return out.exec();
                     } else {
                         RLOG(LL_INFO, "Linking: " + out.path(build_dir).string());
-                        return out.link(compiler, build_dir, object_files, link_flags, linkables);
+                        return out.link(link, build_dir, object_files, jobs);
                     }
                 },
                 value_
             );
         }
 
-        std::vector<std::filesystem::path> listDependencies(const std::string& compiler, const std::vector<std::filesystem::path>& include_paths, const std::vector<std::string>& compile_flags) {
+        std::vector<std::filesystem::path> listDependencies(const __CompileConfig& config) {
             return std::visit(
                 [&](auto& out) -> std::vector<std::filesystem::path> {
                     using T = std::decay_t<decltype(out)>;
 
                     if constexpr (std::same_as<T, Object>) {
-                        return out.listDependencies(compiler, include_paths, compile_flags);
+                        return out.listDependencies(config);
                     } else {
                         return {};
                     }
@@ -1131,55 +1847,132 @@ class Output {
         // Doesn't consider header includes yet (see Object::listDependencies) — only
         // the Object variant's own source file, or the Binary/Library variant's object
         // files. Missing output, or any input newer than the output, means stale.
-        bool isStale(const std::filesystem::path& build_dir, const std::vector<std::filesystem::path>& object_files) const {
-            std::filesystem::path output_path = outputPath(build_dir);
-
+        // Why the output has to be rebuilt regardless of its upstream tasks, or nullopt
+        // if it doesn't. Parents and command lines are Task::needsRebuild()'s business.
+        std::optional<std::string> staleReason(const std::filesystem::path& output_path) const {
+            if (isCommand()) {
+                // No principled way to know if a shell command's effects are up to date
+                // without it telling us what it reads/writes — matches build.h's own
+                // pre-build commands, which also always rerun unconditionally.
+                return "commands always re-run";
+            }
             if (!std::filesystem::exists(output_path)) {
-                return true;
+                return "output missing";
             }
 
             std::filesystem::file_time_type output_time = std::filesystem::last_write_time(output_path);
 
             return std::visit(
-                [&](const auto& out) -> bool {
+                [&](const auto& out) -> std::optional<std::string> {
                     using T = std::decay_t<decltype(out)>;
 
                     if constexpr (std::same_as<T, Object>) {
-                        return std::filesystem::last_write_time(out.sourcePath()) > output_time;
-                    } else if constexpr (std::same_as<T, Command>) {
-                        // No principled way to know if a shell command's effects are
-                        // up to date without it telling us what it reads/writes —
-                        // matches build.h's own pre-build commands, which also always
-                        // rerun unconditionally.
-                        return true;
-                    } else {
-                        for (const auto& object_file : object_files) {
-                            if (!std::filesystem::exists(object_file) || std::filesystem::last_write_time(object_file) > output_time) {
-                                return true;
-                            }
+                        if (std::filesystem::last_write_time(out.sourcePath()) > output_time) {
+                            return "input " + out.sourcePath().string() + " newer than output";
                         }
-                        return false;
                     }
+                    return std::nullopt;
                 },
                 value_
             );
         }
 
-        bool isObject() const { return std::holds_alternative<Object>(value_); }
+        // A link's objects, checked only once no parent turned out stale — an object
+        // its parent just rebuilt is that parent's doing, not a cause of its own.
+        // What's left is an object changed outside this build (e.g. an interrupted
+        // earlier one).
+        std::optional<std::string> staleObjectFile(const std::filesystem::path& output_path, const std::vector<std::filesystem::path>& object_files) const {
+            if (isObject() || isCommand()) {
+                return std::nullopt;
+            }
 
-        // Defined out-of-line, after Build, since Build isn't a complete type yet here.
-        // No-op for every variant except Command, which gets "cmd_<Build::nextCommandId()>".
-        void assignCommandName(Build& build);
+            std::filesystem::file_time_type output_time = std::filesystem::last_write_time(output_path);
+            for (const auto& object_file : object_files) {
+                if (!std::filesystem::exists(object_file)) {
+                    return "input " + object_file.string() + " missing";
+                }
+                if (std::filesystem::last_write_time(object_file) > output_time) {
+                    return "input " + object_file.string() + " newer than output";
+                }
+            }
+            return std::nullopt;
+        }
 
-        // Only the Object variant ever produces a compile-commands entry — Binary/Library
-        // link steps aren't compilations of a translation unit.
-        std::optional<CompileCommandEntry> compileCommandEntry(const std::string& compiler, const std::filesystem::path& build_dir, const std::vector<std::filesystem::path>& include_paths, const std::vector<std::string>& compile_flags) const {
+        // Hash of everything that goes into building the output besides the inputs'
+        // contents: the full compile command, or the link flags, libraries and member
+        // objects. nullopt for Commands, which rerun regardless.
+        std::optional<u64> signature(const __CompileConfig& compile, const __LinkConfig& link, const std::filesystem::path& build_dir,
+                                     const std::vector<std::filesystem::path>& object_files) const {
             return std::visit(
-                [&](const auto& out) -> std::optional<CompileCommandEntry> {
+                [&](const auto& out) -> std::optional<u64> {
                     using T = std::decay_t<decltype(out)>;
 
                     if constexpr (std::same_as<T, Object>) {
-                        return out.compileCommandEntry(compiler, build_dir, include_paths, compile_flags);
+                        return __fnv1a(out.compileCommandEntry(compile, build_dir).command);
+                    } else if constexpr (std::same_as<T, Command>) {
+                        return std::nullopt;
+                    } else {
+                        u64 hash = __fnv1a(out.lto().has_value() ? "lto" : "");
+                        if constexpr (std::same_as<T, Library>) {
+                            hash = __fnv1a(std::to_string(static_cast<i32>(out.linkage())) + std::to_string(static_cast<i32>(out.archiveMode())), hash);
+                        }
+                        // NUL-separated, so {"-la", "b"} and {"-l", "ab"} can't collide.
+                        for (const auto& arg : link.argv) {
+                            hash = __fnv1a(std::string_view(arg.c_str(), arg.size() + 1), hash);
+                        }
+                        for (const auto& linkable : link.linkables) {
+                            hash = __fnv1a(std::string_view(linkable.c_str(), linkable.size() + 1), hash);
+                        }
+                        for (const auto& object_file : object_files) {
+                            hash = __fnv1a(std::string_view(object_file.c_str(), object_file.native().size() + 1), hash);
+                        }
+                        return hash;
+                    }
+                },
+                value_
+            );
+        }
+
+        bool isObject() const { return std::holds_alternative<Object>(value_); }
+
+        bool isCommand() const { return std::holds_alternative<Command>(value_); }
+
+        bool isStaticLibrary() const {
+            const Library* library = std::get_if<Library>(&value_);
+            return library != nullptr && library->linkage() == Linkage::Static;
+        }
+
+        // Relies on the variant's alternatives being listed in TaskKind's order.
+        TaskKind kind() const { return static_cast<TaskKind>(value_.index()); }
+
+        bool isLto() const {
+            return std::visit(
+                [](const auto& out) -> bool {
+                    using T = std::decay_t<decltype(out)>;
+
+                    if constexpr (std::same_as<T, Binary> || std::same_as<T, Library>) {
+                        return out.lto().has_value();
+                    } else {
+                        return false;
+                    }
+                },
+                value_
+            );
+        }
+
+        // Defined out-of-line, after Build, since Build isn't a complete type yet here.
+        // No-op for every variant except Command, which gets "cmd_<Build::nextCommandId()>".
+        void assignCommandName(Build& build);
+
+        // Only the Object variant ever produces a compile-commands entry — Binary/Library
+        // link steps aren't compilations of a translation unit.
+        std::optional<CompileCommandEntry> compileCommandEntry(const __CompileConfig& config, const std::filesystem::path& build_dir) const {
+            return std::visit(
+                [&](const auto& out) -> std::optional<CompileCommandEntry> {
+                    using T = std::decay_t<decltype(out)>;
+
+                    if constexpr (std::same_as<T, Object>) {
+                        return out.compileCommandEntry(config, build_dir);
                     } else {
                         return std::nullopt;
                     }
@@ -1189,143 +1982,621 @@ class Output {
         }
 };
 
+// Length of what std::filesystem::path::stem() would return for this filename,
+// without building a path to ask it.
+inline usize __stemLength(std::string_view filename) {
+    if (filename == "." || filename == "..") {
+        return filename.size();
+    }
+
+    usize dot = filename.rfind('.');
+    return dot == std::string_view::npos || dot == 0 ? filename.size() : dot;
+}
+
+inline std::string_view __filenameOf(std::string_view path) {
+    usize slash = path.rfind('/');
+    return slash == std::string_view::npos ? path : path.substr(slash + 1);
+}
+
+// Every path the DAG keys on, stored once and named by a 32-bit id. Paths go in
+// lexically normal, in generic form, so "src/./a.c" and "src/a.c" get the same id.
+// Each entry keeps its hash, where its filename and stem start, and its stem's own id,
+// so neither lookups nor stem() ever re-parse or re-hash a path. Ids are never freed —
+// a build only ever touches as many paths as it has sources, headers and outputs.
+class PathInterner {
+    public:
+        static constexpr u32 NONE = UINT32_MAX;
+
+    private:
+        struct Entry {
+                std::string text;
+                u64         hash;
+                u32         name_offset;
+                u32         stem_length;
+                u32         stem_id;
+        };
+
+        mutable std::mutex mutex_;
+        // deque: an entry's text never moves, so text() can hand out views of it.
+        std::deque<Entry>  entries_;
+        // Open addressing over ids, linear probing; NONE marks an empty slot.
+        std::vector<u32>   slots_ = std::vector<u32>(1024, NONE);
+
+        u32 findLocked(std::string_view text, u64 hash) const {
+            usize mask = slots_.size() - 1;
+            for (usize slot = hash & mask;; slot = (slot + 1) & mask) {
+                u32 id = slots_[slot];
+                if (id == NONE || (entries_[id].hash == hash && entries_[id].text == text)) {
+                    return id;
+                }
+            }
+        }
+
+        void insertSlot(u32 id) {
+            usize mask = slots_.size() - 1;
+            usize slot = entries_[id].hash & mask;
+            while (slots_[slot] != NONE) {
+                slot = (slot + 1) & mask;
+            }
+            slots_[slot] = id;
+        }
+
+        u32 internLocked(std::string_view text) {
+            u64 hash = std::hash<std::string_view>{}(text);
+            if (u32 found = findLocked(text, hash); found != NONE) {
+                return found;
+            }
+
+            // Grown at half full, so probe runs stay short.
+            if ((entries_.size() + 1) * 2 > slots_.size()) {
+                slots_.assign(slots_.size() * 2, NONE);
+                for (u32 id = 0; id < entries_.size(); ++id) {
+                    insertSlot(id);
+                }
+            }
+
+            u32              id       = static_cast<u32>(entries_.size());
+            std::string_view filename = __filenameOf(text);
+            usize            offset   = text.size() - filename.size();
+            entries_.push_back(Entry{std::string(text), hash, static_cast<u32>(offset), static_cast<u32>(__stemLength(filename)), id});
+            insertSlot(id);
+
+            Entry& entry = entries_[id];
+            if (entry.name_offset != 0 || entry.stem_length != entry.text.size()) {
+                u32 stem_id   = internLocked(std::string_view(entry.text).substr(entry.name_offset, entry.stem_length));
+                entries_[id].stem_id = stem_id;
+            }
+            return id;
+        }
+
+    public:
+        static PathInterner& instance() {
+            static PathInterner interner;
+            return interner;
+        }
+
+        u32 intern(const std::filesystem::path& path) {
+            std::string                 text = path.lexically_normal().generic_string();
+            std::lock_guard<std::mutex> lock(mutex_);
+            return internLocked(text);
+        }
+
+        // NONE if text was never interned. Taken as is — no normalizing.
+        u32 find(std::string_view text) const {
+            u64                         hash = std::hash<std::string_view>{}(text);
+            std::lock_guard<std::mutex> lock(mutex_);
+            return findLocked(text, hash);
+        }
+
+        std::string_view text(u32 id) const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return entries_[id].text;
+        }
+
+        // The id of the path's stem on its own ("foo" for "src/foo.c") — how headers and
+        // the sources that generate them get matched up (see Build::buildDAG).
+        u32 stem(u32 id) const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return entries_[id].stem_id;
+        }
+};
+
+// Open-addressing map from interned path ids to V: linear probing over two flat arrays,
+// with no allocation per entry and no hashing of path text. Ids are dense, so
+// Fibonacci hashing alone spreads them. Never shrinks and has no erase — nothing keyed
+// by a path needs either.
+template <typename V>
+class __PathMap {
+    private:
+        std::vector<u32> keys_;
+        std::vector<V>   values_;
+        usize            size_ = 0;
+
+        usize slotOf(u32 key) const {
+            usize mask = keys_.size() - 1;
+            usize slot = static_cast<usize>((static_cast<u64>(key) * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+            while (keys_[slot] != key && keys_[slot] != PathInterner::NONE) {
+                slot = (slot + 1) & mask;
+            }
+            return slot;
+        }
+
+        void grow() {
+            std::vector<u32> keys   = std::move(keys_);
+            std::vector<V>   values = std::move(values_);
+            keys_.assign(keys.empty() ? 16 : keys.size() * 2, PathInterner::NONE);
+            values_ = std::vector<V>(keys_.size());
+
+            for (usize i = 0; i < keys.size(); ++i) {
+                if (keys[i] != PathInterner::NONE) {
+                    usize slot    = slotOf(keys[i]);
+                    keys_[slot]   = keys[i];
+                    values_[slot] = std::move(values[i]);
+                }
+            }
+        }
+
+    public:
+        V* find(u32 key) {
+            if (keys_.empty()) {
+                return nullptr;
+            }
+            usize slot = slotOf(key);
+            return keys_[slot] == key ? &values_[slot] : nullptr;
+        }
+
+        const V* find(u32 key) const { return const_cast<__PathMap*>(this)->find(key); }
+
+        bool contains(u32 key) const { return find(key) != nullptr; }
+
+        V& operator[](u32 key) {
+            if ((size_ + 1) * 2 > keys_.size()) {
+                grow();
+            }
+
+            usize slot = slotOf(key);
+            if (keys_[slot] != key) {
+                keys_[slot] = key;
+                ++size_;
+            }
+            return values_[slot];
+        }
+
+        usize size() const { return size_; }
+
+        // f(key, value) for every entry, in no particular order.
+        template <typename F>
+        void forEach(F&& f) const {
+            for (usize i = 0; i < keys_.size(); ++i) {
+                if (keys_[i] != PathInterner::NONE) {
+                    f(keys_[i], values_[i]);
+                }
+            }
+        }
+};
+
 class Task;
+class TaskGraph;
 class BuildGroup;
 class Build;
+class ThreadPool;
+class __CommandSignatures;
+class __RebuildExplainer;
 
 // A single task: owns the Output it produces (an Object, Binary, or Library), plus its
 // place in the dependency DAG. Set once the task is registered (see
 // BuildGroup::addTask). execute() reaches build_dir through group_ -> Build rather than
 // taking it as a parameter, since nothing here owns it.
+//
+// Only the edges are collected here, while the DAG is being put together. Once
+// TaskGraph::freeze() has run, the graph owns both the edges and the state each
+// dispatch reads and writes per task, and a Task is left holding what never changes
+// mid-build.
 class Task {
     private:
+        friend class TaskGraph;
+
         Output                    output_;
-        BuildGroup*                group_ = nullptr;
-        std::vector<Task*>        children_;
+        BuildGroup*               group_ = nullptr;
+        // Until freeze(), which moves these into the graph's CSR arrays and frees them.
         std::vector<Task*>        parents_;
-        std::atomic<i32>          parent_count_;
-        std::optional<bool>       needs_rebuild_;
+        TaskGraph*                graph_ = nullptr;
+        u32                       id_    = 0;
+        // Interned sourcePath() (see BuildGroup::addTask).
+        u32                       source_id_ = PathInterner::NONE;
+        // outputPath() under the current dispatch's build dir, resolved once up front
+        // by Build::runDAG() instead of rebuilt by every caller.
+        std::filesystem::path     output_path_;
+        // Set on Objects feeding a ThinLTO link (see Build::markLtoObjects).
+        bool                      lto_ = false;
+        // Not part of this run at all — outside this CI shard's portion of the DAG, or
+        // an Object whose output a --shard-merge run takes from the shards' artifacts.
+        bool                      excluded_ = false;
 
     public:
-        Task(Output output) : output_(std::move(output)), parent_count_(0) {}
+        Task(Output output) : output_(std::move(output)) {}
 
         // Walks parents_ transitively looking for candidate. Used by depends_on() to
         // reject an edge that would close a cycle, before it's ever added — a task
-        // stuck with parentCount() > 0 forever otherwise just spins Build::build()'s
-        // dispatch loop at 100% CPU with no error and no way out.
+        // stuck with a parent count above 0 forever otherwise never becomes ready, and
+        // Build::build() blocks waiting for the DAG to drain with no error and no way
+        // out. Each ancestor is visited once, however many paths lead to it.
         bool hasAncestor(const Task* candidate) const {
-            for (Task* parent : parents_) {
-                if (parent == candidate || parent->hasAncestor(candidate)) {
+            std::vector<const Task*>        stack(parents_.begin(), parents_.end());
+            std::unordered_set<const Task*> visited;
+            while (!stack.empty()) {
+                const Task* task = stack.back();
+                stack.pop_back();
+
+                if (task == candidate) {
                     return true;
                 }
+                if (visited.insert(task).second) {
+                    stack.insert(stack.end(), task->parents_.begin(), task->parents_.end());
+                }
             }
             return false;
         }
 
         Task& depends_on(Task& dependency) {
+            if (graph_ != nullptr) {
+                RLOG(LL_FATAL, "Can't add a dependency to \"" + sourcePath().string() + "\" once the task graph is frozen");
+            }
             if (&dependency == this || dependency.hasAncestor(this)) {
                 RLOG(LL_FATAL, "Dependency cycle: \"" + sourcePath().string() + "\" -> \"" + dependency.sourcePath().string() + "\"");
             }
 
-            dependency.children_.push_back(this);
             parents_.push_back(&dependency);
-            ++parent_count_;
             return *this;
         }
 
+        // depends_on() without the cycle check, for an edge that already passed it on
+        // an earlier run with the very same tasks and edges (see __DagManifest).
+        void restoreDependency(Task& dependency) { parents_.push_back(&dependency); }
+
+        // Only until TaskGraph::freeze() (see parents_).
+        const std::vector<Task*>& dependencies() const { return parents_; }
+
         void setGroup(BuildGroup& group) { group_ = &group; }
 
-        // True on success. CommandOutput's exit_code was previously discarded here —
-        // this is the one place that actually inspects it. Defined out-of-line, after
-        // BuildGroup, since BuildGroup isn't a complete type yet here.
-        bool execute();
+        // Hands back the whole CommandOutput, not just success — Build::runTask both
+        // checks its exit_code and records its timings and peak RSS into the build
+        // history. Defined out-of-line, after BuildGroup, since BuildGroup isn't a
+        // complete type yet here.
+        CommandOutput execute();
 
-        std::vector<std::filesystem::path> listDependencies(const std::filesystem::path& build_dir);
+        std::vector<std::filesystem::path> listDependencies();
 
         std::optional<CompileCommandEntry> compileCommandEntry();
 
+        // See Output::signature. Defined out-of-line, after BuildGroup.
+        std::optional<u64> signature() const { return signature(collectObjectFiles()); }
+
         // Memoized: own staleness OR any parent's (recursive). Safe to call from
-        // multiple worker threads without locking the cache — a task is only ever
-        // dispatched after every parent's needsRebuild()+complete() has already run on
-        // its own thread, and complete()'s atomic decrement of parent_count_ is what
-        // publishes that thread's writes (including needs_rebuild_) before this task's
-        // parentCount() is observed as 0 and it gets picked up.
+        // multiple worker threads — a task is only ever dispatched after every
+        // parent's needsRebuild()+complete() has already run on its own thread, and
+        // complete()'s atomic decrement of the pending parent count is what publishes
+        // that thread's writes to whichever thread's decrement takes it to 0 and pushes
+        // it. Defined out-of-line, after TaskGraph, like everything else that reads the
+        // per-dispatch state.
         bool needsRebuild();
 
         const std::filesystem::path& sourcePath() const { return output_.sourcePath(); }
 
+        u32 sourceId() const { return source_id_; }
+
+        void setSourceId(u32 id) { source_id_ = id; }
+
         std::filesystem::path outputPath(const std::filesystem::path& build_dir) const { return output_.outputPath(build_dir); }
 
+        // Only valid from resolveOutputPath() on — i.e. during a dispatch.
+        const std::filesystem::path& outputPath() const { return output_path_; }
+
+        void resolveOutputPath(const std::filesystem::path& build_dir) { output_path_ = output_.outputPath(build_dir); }
+
         bool isObject() const { return output_.isObject(); }
 
-        const std::vector<Task*>& parents() const { return parents_; }
+        bool isCommand() const { return output_.isCommand(); }
+
+        bool isStaticLibrary() const { return output_.isStaticLibrary(); }
+
+        bool isLto() const { return output_.isLto(); }
+
+        TaskKind kind() const { return output_.kind(); }
+
+        // Dense index into the graph's arrays, assigned by freeze() in registration
+        // order.
+        u32 id() const { return id_; }
+
+        f64 priority() const;
+
+        u64 memoryEstimate() const;
+
+        // The group's setMemoryHint(), if any. Defined out-of-line, after BuildGroup.
+        std::optional<u64> memoryHint() const;
+
+        const std::string& groupName() const;
+
+        void setLto() { lto_ = true; }
+
+        void markFailed();
+
+        bool excluded() const { return excluded_; }
+
+        void setExcluded() { excluded_ = true; }
+
+        bool upstreamFailed() const;
 
-        i32 parentCount() const { return parent_count_.load(); }
+        // Pushes each child whose last outstanding parent this was straight onto the
+        // pool's ready queue — exactly one thread ever sees a given child's count hit
+        // 0, so nothing gets pushed twice. Defined out-of-line, after ThreadPool.
+        void complete(ThreadPool& pool);
 
-        void complete() {
-            for (Task* child : children_) {
-                if (child->parent_count_.load() != 0) {
-                    --child->parent_count_;
+        void print() const;
+
+    private:
+        // Every upstream task's compiled output path, each ancestor once however many
+        // paths lead to it. Read-only: the DAG edges themselves are built once by
+        // depends_on(), not here. Only Object-backed tasks contribute — a Command (or,
+        // transitively, another Binary/Library) sitting somewhere in the ancestor chain
+        // has no real object file to hand the linker.
+        std::vector<std::filesystem::path> collectObjectFiles() const;
+
+        std::optional<u64> signature(const std::vector<std::filesystem::path>& object_files) const;
+};
+
+// The DAG once every edge is in. Tasks are numbered densely in registration order; the
+// edges are stored as compressed sparse rows, one offsets array into one flat id array
+// per direction; and everything a dispatch reads and writes per task lives in arrays
+// indexed by id rather than in the Tasks themselves. Resetting, ranking and walking the
+// graph are then linear scans over a few contiguous arrays instead of pointer-chasing
+// through separately allocated Tasks and their own vectors.
+class TaskGraph {
+    private:
+        std::vector<Task*> tasks_;
+        // size() + 1 entries each: task i's parents are parent_ids_[parent_offsets_[i]]
+        // up to parent_ids_[parent_offsets_[i + 1]], and likewise for children.
+        std::vector<u32>   parent_offsets_;
+        std::vector<u32>   parent_ids_;
+        std::vector<u32>   child_offsets_;
+        std::vector<u32>   child_ids_;
+        // Every parent before any of its children.
+        std::vector<u32>   topological_order_;
+        std::vector<u32>   roots_;
+
+        std::unique_ptr<std::atomic<i32>[]> pending_parents_;
+        // 0 = not worked out yet, 1 = up to date, 2 = stale. Atomic because an excluded
+        // parent never runs, so its children work it out lazily, maybe several at once
+        // — all to the same answer.
+        std::unique_ptr<std::atomic<u8>[]> needs_rebuild_;
+        // Set when a task failed or was skipped, so its children skip in turn. Written
+        // by the task's own worker, read by a child only after that task's complete().
+        std::vector<u8>    failed_;
+        // Estimated seconds from a task's start to the end of the longest path through
+        // its descendants (see Build::computePriorities) — the ready queue always hands
+        // out the highest first.
+        std::vector<f64>   priority_;
+        // Expected peak RSS in bytes, charged against the pool's memory budget for as
+        // long as the task executes (see Build::estimateMemory).
+        std::vector<u64>   memory_estimate_;
+        // When each task's last parent complete()d, for --trace's queue-wait time.
+        // Empty, and never touched, unless trackReadyTimes() was called.
+        std::vector<i64>   ready_ns_;
+
+    public:
+        // Numbers tasks in the order given and takes over their edges. Tasks can't be
+        // added, and edges can't change, from here on.
+        void freeze(const std::vector<Task*>& tasks) {
+            usize count = tasks.size();
+            tasks_      = tasks;
+            for (usize i = 0; i < count; ++i) {
+                tasks_[i]->graph_ = this;
+                tasks_[i]->id_    = static_cast<u32>(i);
+            }
+
+            parent_offsets_.assign(count + 1, 0);
+            child_offsets_.assign(count + 1, 0);
+            for (usize i = 0; i < count; ++i) {
+                parent_offsets_[i + 1] = parent_offsets_[i] + static_cast<u32>(tasks_[i]->parents_.size());
+                for (const Task* parent : tasks_[i]->parents_) {
+                    ++child_offsets_[parent->id_ + 1];
+                }
+            }
+            for (usize i = 0; i < count; ++i) {
+                child_offsets_[i + 1] += child_offsets_[i];
+            }
+
+            parent_ids_.resize(parent_offsets_[count]);
+            child_ids_.resize(child_offsets_[count]);
+            std::vector<u32> child_fill(child_offsets_.begin(), child_offsets_.end() - 1);
+            for (usize i = 0; i < count; ++i) {
+                u32 slot = parent_offsets_[i];
+                for (const Task* parent : tasks_[i]->parents_) {
+                    parent_ids_[slot++]                = parent->id_;
+                    child_ids_[child_fill[parent->id_]++] = static_cast<u32>(i);
+                }
+                std::vector<Task*>().swap(tasks_[i]->parents_);
+            }
+
+            // Kahn's algorithm. depends_on() already refuses cycles, so this always
+            // reaches every task.
+            std::vector<u32> remaining(count);
+            topological_order_.clear();
+            roots_.clear();
+            for (usize i = 0; i < count; ++i) {
+                remaining[i] = parent_offsets_[i + 1] - parent_offsets_[i];
+                if (remaining[i] == 0) {
+                    roots_.push_back(static_cast<u32>(i));
+                    topological_order_.push_back(static_cast<u32>(i));
                 }
             }
+            for (usize next = 0; next < topological_order_.size(); ++next) {
+                for (u32 child : children(topological_order_[next])) {
+                    if (--remaining[child] == 0) {
+                        topological_order_.push_back(child);
+                    }
+                }
+            }
+
+            pending_parents_.reset(new std::atomic<i32>[count]);
+            needs_rebuild_.reset(new std::atomic<u8>[count]);
+            failed_.assign(count, 0);
+            priority_.assign(count, 0.0);
+            memory_estimate_.assign(count, 0);
+            reset();
+        }
+
+        usize size() const { return tasks_.size(); }
+
+        Task* task(u32 id) const { return tasks_[id]; }
+
+        std::span<const u32> parents(u32 id) const {
+            return {parent_ids_.data() + parent_offsets_[id], parent_ids_.data() + parent_offsets_[id + 1]};
         }
 
-        void print() const {
-            std::ostringstream oss;
-            oss << "Task " << sourcePath().filename().string() << ": parents=" << parent_count_.load() << ", children=[";
-            for (usize i = 0; i < children_.size(); ++i) {
-                if (i > 0) oss << ", ";
-                oss << children_[i]->sourcePath().filename().string();
+        std::span<const u32> children(u32 id) const {
+            return {child_ids_.data() + child_offsets_[id], child_ids_.data() + child_offsets_[id + 1]};
+        }
+
+        const std::vector<u32>& topologicalOrder() const { return topological_order_; }
+
+        const std::vector<u32>& roots() const { return roots_; }
+
+        // Puts every task back to how freeze() left it, so the same DAG can be
+        // dispatched again (e.g. once per PGO phase, each into a different build dir).
+        void reset() {
+            for (usize i = 0; i < tasks_.size(); ++i) {
+                pending_parents_[i].store(static_cast<i32>(parent_offsets_[i + 1] - parent_offsets_[i]), std::memory_order_relaxed);
+                needs_rebuild_[i].store(0, std::memory_order_relaxed);
             }
-            oss << "]";
-            RLOG(LL_DEBUG, oss.str());
+            std::fill(failed_.begin(), failed_.end(), 0);
         }
 
-    private:
-        // Walks parents() transitively, collecting each upstream task's compiled
-        // output path, deduplicated for diamond dependencies. Read-only: the DAG edges
-        // themselves are built once by depends_on(), not here. Only Object-backed
-        // tasks contribute — a Command (or, transitively, another Binary/Library)
-        // sitting somewhere in the ancestor chain has no real object file to hand the
-        // linker.
-        std::vector<std::filesystem::path> collectObjectFiles(const std::filesystem::path& build_dir) const {
-            std::vector<std::filesystem::path> object_files;
-            std::unordered_set<const Task*>    visited;
-
-            std::function<void(const Task*)> collect = [&](const Task* task) {
-                if (visited.contains(task)) {
-                    return;
-                }
-                visited.insert(task);
+        i32 pendingParents(u32 id) const { return pending_parents_[id].load(); }
+
+        std::optional<bool> needsRebuild(u32 id) const {
+            u8 state = needs_rebuild_[id].load(std::memory_order_relaxed);
+            return state == 0 ? std::nullopt : std::optional<bool>(state == 2);
+        }
+
+        void setNeedsRebuild(u32 id, bool stale) { needs_rebuild_[id].store(stale ? 2 : 1, std::memory_order_relaxed); }
 
-                if (task->isObject()) {
-                    object_files.push_back(task->outputPath(build_dir));
+        void markFailed(u32 id) { failed_[id] = 1; }
+
+        bool upstreamFailed(u32 id) const {
+            for (u32 parent : parents(id)) {
+                if (failed_[parent]) {
+                    return true;
                 }
+            }
+            return false;
+        }
+
+        f64 priority(u32 id) const { return priority_[id]; }
 
-                for (Task* parent : task->parents()) {
-                    collect(parent);
+        void setPriority(u32 id, f64 priority) { priority_[id] = priority; }
+
+        u64 memoryEstimate(u32 id) const { return memory_estimate_[id]; }
+
+        void setMemoryEstimate(u32 id, u64 bytes) { memory_estimate_[id] = bytes; }
+
+        void trackReadyTimes() { ready_ns_.assign(size(), 0); }
+
+        void setReadyTime(u32 id, i64 ns) {
+            if (!ready_ns_.empty()) {
+                ready_ns_[id] = ns;
+            }
+        }
+
+        i64 readyTime(u32 id) const { return ready_ns_.empty() ? 0 : ready_ns_[id]; }
+
+        // Calls visit(ancestor_id) once per task upstream of id, depth-first, parents in
+        // the order their edges were added. Ancestors already marked in visited (sized
+        // size()) are skipped along with their own ancestors, so several walks can share
+        // one visited array. A visit that returns bool prunes the walk there on false —
+        // the ancestor itself is still visited, its own ancestors aren't.
+        template <typename F>
+        void forEachAncestor(u32 id, std::vector<u8>& visited, F&& visit) const {
+            std::vector<u32> stack(parents(id).rbegin(), parents(id).rend());
+            while (!stack.empty()) {
+                u32 ancestor = stack.back();
+                stack.pop_back();
+                if (visited[ancestor]) {
+                    continue;
                 }
-            };
 
-            for (Task* parent : parents_) {
-                collect(parent);
+                visited[ancestor] = 1;
+                if constexpr (std::same_as<std::invoke_result_t<F&, u32>, bool>) {
+                    if (!visit(ancestor)) {
+                        continue;
+                    }
+                } else {
+                    visit(ancestor);
+                }
+                std::span<const u32> next = parents(ancestor);
+                stack.insert(stack.end(), next.rbegin(), next.rend());
             }
+        }
 
-            return object_files;
+        template <typename F>
+        void forEachAncestor(u32 id, F&& visit) const {
+            std::vector<u8> visited(size(), 0);
+            forEachAncestor(id, visited, std::forward<F>(visit));
         }
+
+        // Defined out-of-line, after ThreadPool (see Task::complete).
+        void complete(u32 id, ThreadPool& pool);
 };
 
+inline f64 Task::priority() const { return graph_->priority(id_); }
+
+inline u64 Task::memoryEstimate() const { return graph_->memoryEstimate(id_); }
+
+inline void Task::markFailed() { graph_->markFailed(id_); }
+
+inline bool Task::upstreamFailed() const { return graph_->upstreamFailed(id_); }
+
+inline std::vector<std::filesystem::path> Task::collectObjectFiles() const {
+    std::vector<std::filesystem::path> object_files;
+    graph_->forEachAncestor(id_, [&](u32 ancestor) {
+        if (graph_->task(ancestor)->isObject()) {
+            object_files.push_back(graph_->task(ancestor)->outputPath());
+        }
+    });
+    return object_files;
+}
+
+inline void Task::print() const {
+    std::ostringstream oss;
+    oss << "Task " << sourcePath().filename().string() << ": parents=" << graph_->parents(id_).size() << ", children=[";
+    std::span<const u32> children = graph_->children(id_);
+    for (usize i = 0; i < children.size(); ++i) {
+        if (i > 0) oss << ", ";
+        oss << graph_->task(children[i])->sourcePath().filename().string();
+    }
+    oss << "]";
+    RLOG(LL_DEBUG, oss.str());
+}
+
 // Concrete (not templated on Include/Link kinds — see __IncludeVariant/__LinkVariant):
 // this is what lets Build own a homogeneous collection of these directly instead of
 // needing a type-erased base class.
 class BuildGroup {
     private:
-        std::unordered_map<std::filesystem::path, std::unique_ptr<Task>> tasks_;
-        std::vector<__IncludeVariant>                                    includes_;
-        std::optional<std::string>                                       compiler_;
-        std::vector<std::string>                                         compile_flags_;
-        std::vector<std::string>                                         link_flags_;
-        std::vector<__LinkVariant>                                       links_;
+        // Owned by Build's task pool (see Build::newTask) — this only indexes its own.
+        __PathMap<Task*>                                 tasks_;
+        std::vector<__IncludeVariant>                    includes_;
+        std::optional<std::string>                       compiler_;
+        std::vector<std::string>                         compile_flags_;
+        std::vector<std::string>                         link_flags_;
+        std::vector<__LinkVariant>                       links_;
+        std::optional<u64>                               memory_hint_;
+        std::string                                      name_;
+        // Rendered by freeze(), read by every task of the group during a dispatch.
+        __CompileConfig                                  compile_config_;
+        // The same plus -flto=thin, for Objects feeding a ThinLTO link.
+        __CompileConfig                                  lto_compile_config_;
+        __LinkConfig                                     link_config_;
 
         // Set once the group is registered (see Build::addGroup).
         Build* build_ = nullptr;
@@ -1343,9 +2614,26 @@ class BuildGroup {
 
         void setBuild(Build& build) { build_ = &build; }
 
+        // Labels this group's tasks in --metrics output.
+        void setName(const std::string& name) { name_ = name; }
+
+        const std::string& name() const { return name_; }
+
         // Defined out-of-line, after Build, since Build isn't a complete type yet here.
         const std::filesystem::path& buildDir() const;
 
+        bool forceRebuild() const;
+
+        bool timeTrace() const;
+
+        __CommandSignatures& commandSignatures() const;
+
+        __RebuildExplainer& explainer() const;
+
+        i32 jobs() const;
+
+        RemoteExecutor* remote() const;
+
         template <__IsInclude T>
         void addInclude(T include) { includes_.emplace_back(std::move(include)); }
 
@@ -1353,25 +2641,19 @@ class BuildGroup {
 
         void addLinkFlag(const std::string& flag) { link_flags_.push_back(flag); }
 
-        template <__IsLink T>
-        void addLink(T link) { links_.emplace_back(std::move(link)); }
+        // Expected peak RSS, in bytes, of any one of this group's tasks — only used
+        // for tasks with no peak RSS in the build history yet, e.g. on a fresh CI
+        // checkout. Set it for template-heavy groups so even a first build at high -j
+        // stays inside the memory budget.
+        void setMemoryHint(u64 bytes) { memory_hint_ = bytes; }
 
-        Task& addTask(Output output) {
-            output.assignCommandName(*build_);
+        const std::optional<u64>& memoryHint() const { return memory_hint_; }
 
-            Task&                  new_task = *(new Task(std::move(output)));
-            new_task.setGroup(*this);
-            // Full path, not stem: two components can each own a same-named file
-            // (e.g. hardware_flash/flash.c and pico_flash/flash.c) without colliding.
-            std::filesystem::path key = new_task.sourcePath();
-
-            if (tasks_.contains(key)) {
-                RLOG(LL_FATAL, "Task name collision: \"" + key.string() + "\" is already registered in this group — choose a different name");
-            }
+        template <__IsLink T>
+        void addLink(T link) { links_.emplace_back(std::move(link)); }
 
-            tasks_[key] = std::unique_ptr<Task>(&new_task);
-            return new_task;
-        }
+        // Defined out-of-line, after Build, which owns the storage.
+        Task& addTask(Output output);
 
         Task& addTask(Output output, std::initializer_list<std::reference_wrapper<Task>> dependencies) {
             Task& new_task = addTask(std::move(output));
@@ -1381,28 +2663,1468 @@ class BuildGroup {
             return new_task;
         }
 
-        std::unordered_map<std::filesystem::path, std::unique_ptr<Task>>& tasks() { return tasks_; }
+        // Keyed by each task's interned sourcePath().
+        const __PathMap<Task*>& tasks() const { return tasks_; }
+
+        std::string& compiler() { return *compiler_; }
+
+        // Resolves the group's includes, flags and links for the current build dir and
+        // phase, once for all of its tasks instead of once per task — include paths are
+        // made relative, and symlinks checked and created, here and nowhere else. Build
+        // calls it before every pass over the DAG; the result is read-only while tasks
+        // run. Defined out-of-line, after Build: the phase's flags go on top of the
+        // group's own (see Build::phaseCompileFlags).
+        void freeze();
+
+        const __CompileConfig& compileConfig(bool lto) const { return lto ? lto_compile_config_ : compile_config_; }
+
+        const __LinkConfig& linkConfig() const { return link_config_; }
+};
+
+// What happened to a task in one run. Stored as a raw byte, so only ever append.
+// Skipped: never ran, or was cut short — downstream of a failure, or the build was
+// stopped or cancelled first.
+enum class TaskOutcome : u8 { Executed, UpToDate, Failed, Skipped };
+
+struct HistoryRecord {
+        u64         run_id;
+        f64         wall_seconds;
+        f64         cpu_seconds;
+        u64         peak_rss_bytes;
+        i32         exit_code;
+        TaskOutcome outcome;
+        TaskKind    kind;
+        // The task's output path — unique across groups, and stable from run to run.
+        std::string key;
+};
+
+// Durable per-task record of every build, as a compact append-only binary log in
+// build_dir: a "BCH1" magic, then one fixed 40-byte header per record (the numeric
+// fields above, native-endian — it never leaves the machine that wrote it) followed
+// by the key bytes. Records are buffered in memory during the build and appended in
+// one write at the end. Once the log holds more than 2 * MAX_RUNS runs it's rewritten
+// with only the newest MAX_RUNS — one full rewrite every MAX_RUNS builds, rather than
+// one on every build as soon as the log is full.
+class BuildHistory {
+    public:
+        static constexpr usize MAX_RUNS = 50;
+
+    private:
+        static constexpr char MAGIC[4]    = {'B', 'C', 'H', '1'};
+        static constexpr usize HEADER_SIZE = 8 + 8 + 8 + 8 + 4 + 1 + 1 + 2;
+
+        std::vector<HistoryRecord> records_;
+        usize                      loaded_count_ = 0;
+        std::mutex                 mutex_;
+        // Newest Executed wall time per key, for scheduling (see
+        // Build::computePriorities) — kept up to date as records come in.
+        std::unordered_map<std::string, f64> last_wall_;
+        // Worst Executed peak RSS per key across every retained run, for memory
+        // admission (see Build::estimateMemory) — the worst, not the latest, since
+        // underestimating is what gets a build OOM-killed.
+        std::unordered_map<std::string, u64> peak_rss_;
+
+        void index(const HistoryRecord& record) {
+            if (record.outcome != TaskOutcome::Executed) {
+                return;
+            }
+            last_wall_[record.key] = record.wall_seconds;
+            u64& peak              = peak_rss_[record.key];
+            peak                   = std::max(peak, record.peak_rss_bytes);
+        }
+
+        static void put(std::string& out, const void* data, usize size) { out.append(static_cast<const char*>(data), size); }
+
+        static void encode(std::string& out, const HistoryRecord& record) {
+            u8  outcome    = static_cast<u8>(record.outcome);
+            u8  kind       = static_cast<u8>(record.kind);
+            u16 key_length = static_cast<u16>(std::min<usize>(record.key.size(), UINT16_MAX));
+
+            put(out, &record.run_id, 8);
+            put(out, &record.wall_seconds, 8);
+            put(out, &record.cpu_seconds, 8);
+            put(out, &record.peak_rss_bytes, 8);
+            put(out, &record.exit_code, 4);
+            put(out, &outcome, 1);
+            put(out, &kind, 1);
+            put(out, &key_length, 2);
+            out.append(record.key, 0, key_length);
+        }
+
+    public:
+        void load(const std::filesystem::path& path) {
+            std::ifstream file(path, std::ios::binary);
+            std::string   data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+            if (data.size() < sizeof(MAGIC) || memcmp(data.data(), MAGIC, sizeof(MAGIC)) != 0) {
+                return;
+            }
+
+            usize offset = sizeof(MAGIC);
+            while (offset + HEADER_SIZE <= data.size()) {
+                HistoryRecord record;
+                u8            outcome;
+                u8            kind;
+                u16           key_length;
+                const char*   at = data.data() + offset;
+
+                memcpy(&record.run_id, at, 8);
+                memcpy(&record.wall_seconds, at + 8, 8);
+                memcpy(&record.cpu_seconds, at + 16, 8);
+                memcpy(&record.peak_rss_bytes, at + 24, 8);
+                memcpy(&record.exit_code, at + 32, 4);
+                memcpy(&outcome, at + 36, 1);
+                memcpy(&kind, at + 37, 1);
+                memcpy(&key_length, at + 38, 2);
+
+                // A torn final record (killed mid-write) just ends the log there.
+                if (offset + HEADER_SIZE + key_length > data.size()) {
+                    break;
+                }
+
+                record.outcome = static_cast<TaskOutcome>(outcome);
+                record.kind    = static_cast<TaskKind>(kind);
+                record.key.assign(at + HEADER_SIZE, key_length);
+                offset += HEADER_SIZE + key_length;
+
+                index(record);
+                records_.push_back(std::move(record));
+            }
+
+            loaded_count_ = records_.size();
+        }
+
+        // Appends just this run's records, unless the log has grown past 2 * MAX_RUNS —
+        // then it's rewritten from scratch with only the newest MAX_RUNS.
+        void save(const std::filesystem::path& path) {
+            std::lock_guard<std::mutex> lock(mutex_);
+
+            std::vector<u64> runs;
+            for (const auto& record : records_) {
+                if (runs.empty() || runs.back() != record.run_id) {
+                    runs.push_back(record.run_id);
+                }
+            }
+
+            bool        compact = runs.size() > 2 * MAX_RUNS;
+            bool        rewrite = compact || loaded_count_ == 0;
+            usize       first   = rewrite ? 0 : loaded_count_;
+            u64         oldest  = compact ? runs[runs.size() - MAX_RUNS] : 0;
+            std::string out;
+
+            if (rewrite) {
+                put(out, MAGIC, sizeof(MAGIC));
+            }
+            for (usize i = first; i < records_.size(); ++i) {
+                if (records_[i].run_id >= oldest) {
+                    encode(out, records_[i]);
+                }
+            }
+
+            std::ofstream file(path, rewrite ? std::ios::binary | std::ios::trunc : std::ios::binary | std::ios::app);
+            if (!file) {
+                RLOG(LL_ERROR, "Failed to open " + path.string());
+                return;
+            }
+            file.write(out.data(), static_cast<std::streamsize>(out.size()));
+        }
+
+        // Called from worker threads, hence the lock — load()/save()/the readers below
+        // only ever run on the main thread with no dispatch in flight (which is why
+        // memory estimates are worked out ahead of a dispatch, not by workers).
+        void record(HistoryRecord record) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            index(record);
+            records_.push_back(std::move(record));
+        }
 
-        std::vector<std::filesystem::path> includePaths(const std::filesystem::path& sym_links) {
-            std::vector<std::filesystem::path> paths;
-            for (auto& include : includes_) {
-                paths.push_back(std::visit([&](const auto& inc) { return inc.path(sym_links); }, include));
+        const std::vector<HistoryRecord>& records() const { return records_; }
+
+        std::optional<f64> lastDuration(const std::string& key) const {
+            auto it = last_wall_.find(key);
+            if (it == last_wall_.end()) {
+                return std::nullopt;
+            }
+            return it->second;
+        }
+
+        std::optional<u64> peakRss(const std::string& key) const {
+            auto it = peak_rss_.find(key);
+            if (it == peak_rss_.end()) {
+                return std::nullopt;
+            }
+            return it->second;
+        }
+
+        // Same idea as meanDuration(), for a task with no RSS on record and no group
+        // hint. 0 on a first-ever build, which leaves admission unthrottled — there's
+        // nothing yet to estimate from.
+        u64 meanPeakRss() const {
+            if (peak_rss_.empty()) {
+                return 0;
+            }
+
+            u64 total = 0;
+            for (const auto& [key, bytes] : peak_rss_) {
+                total += bytes;
+            }
+            return total / peak_rss_.size();
+        }
+
+        // Stand-in for a task that has never run: the mean of everything that has, or
+        // a flat second on a first-ever build, so unknown tasks still rank by how much
+        // work is stacked up behind them.
+        f64 meanDuration() const {
+            if (last_wall_.empty()) {
+                return 1.0;
+            }
+
+            f64 total = 0.0;
+            for (const auto& [key, seconds] : last_wall_) {
+                total += seconds;
+            }
+            return total / static_cast<f64>(last_wall_.size());
+        }
+
+        // Backs ./build --stats: slowest translation units, heaviest memory users, and
+        // per-run totals, newest runs last.
+        void report(usize top = 10) const {
+            struct Summary {
+                    f64   total_wall = 0.0;
+                    f64   last_wall  = 0.0;
+                    f64   max_wall   = 0.0;
+                    u64   max_rss    = 0;
+                    usize runs       = 0;
+                    TaskKind kind    = TaskKind::Object;
+            };
+
+            struct RunTotals {
+                    u64   run_id    = 0;
+                    usize executed  = 0;
+                    usize up_to_date = 0;
+                    usize failed    = 0;
+                    usize skipped   = 0;
+                    f64   wall      = 0.0;
+                    f64   cpu       = 0.0;
+                    u64   max_rss   = 0;
+            };
+
+            std::unordered_map<std::string, Summary> by_key;
+            std::vector<RunTotals>                   runs;
+
+            for (const auto& record : records_) {
+                if (runs.empty() || runs.back().run_id != record.run_id) {
+                    runs.push_back(RunTotals{.run_id = record.run_id});
+                }
+                RunTotals& run = runs.back();
+
+                if (record.outcome == TaskOutcome::UpToDate || record.outcome == TaskOutcome::Skipped) {
+                    ++(record.outcome == TaskOutcome::UpToDate ? run.up_to_date : run.skipped);
+                    continue;
+                }
+
+                ++(record.outcome == TaskOutcome::Failed ? run.failed : run.executed);
+                run.wall += record.wall_seconds;
+                run.cpu += record.cpu_seconds;
+                run.max_rss = std::max(run.max_rss, record.peak_rss_bytes);
+
+                Summary& summary = by_key[record.key];
+                summary.total_wall += record.wall_seconds;
+                summary.last_wall = record.wall_seconds;
+                summary.max_wall  = std::max(summary.max_wall, record.wall_seconds);
+                summary.max_rss   = std::max(summary.max_rss, record.peak_rss_bytes);
+                summary.kind      = record.kind;
+                ++summary.runs;
+            }
+
+            if (runs.empty()) {
+                RLOG(LL_INFO, "No build history recorded yet");
+                return;
+            }
+
+            std::vector<std::pair<std::string, Summary>> objects;
+            std::vector<std::pair<std::string, Summary>> everything(by_key.begin(), by_key.end());
+            for (const auto& entry : everything) {
+                if (entry.second.kind == TaskKind::Object) {
+                    objects.push_back(entry);
+                }
+            }
+
+            std::sort(objects.begin(), objects.end(), [](const auto& a, const auto& b) {
+                return a.second.total_wall / a.second.runs > b.second.total_wall / b.second.runs;
+            });
+            RLOG(LL_INFO, "Slowest translation units (mean / last / max wall seconds, runs):");
+            for (usize i = 0; i < std::min(top, objects.size()); ++i) {
+                const auto& [key, summary] = objects[i];
+                f64 mean = summary.total_wall / summary.runs;
+                // Last against mean is the per-TU trend: a TU getting steadily slower
+                // shows up as a last well above its own mean.
+                RLOG(
+                    LL_INFO, "  %8.2f %8.2f %8.2f %4zu  %+6.0f%%  %s", mean, summary.last_wall, summary.max_wall, summary.runs,
+                    mean > 0.0 ? (summary.last_wall - mean) / mean * 100.0 : 0.0, key.c_str()
+                );
+            }
+
+            std::sort(everything.begin(), everything.end(), [](const auto& a, const auto& b) { return a.second.max_rss > b.second.max_rss; });
+            RLOG(LL_INFO, "Heaviest memory consumers (peak RSS):");
+            for (usize i = 0; i < std::min(top, everything.size()); ++i) {
+                const auto& [key, summary] = everything[i];
+                RLOG(LL_INFO, "  %9.1f MiB  %-7s  %s", summary.max_rss / (1024.0 * 1024.0), __taskKindName(summary.kind), key.c_str());
+            }
+
+            RLOG(LL_INFO, "Recent runs (executed / up to date / failed / skipped, summed task wall and CPU seconds, peak RSS):");
+            for (usize i = runs.size() > top ? runs.size() - top : 0; i < runs.size(); ++i) {
+                const RunTotals& run     = runs[i];
+                time_t           started = static_cast<time_t>(run.run_id / 1000000000ull);
+                char             when[32];
+                strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", localtime(&started));
+                RLOG(
+                    LL_INFO, "  %s  %5zu %5zu %4zu %5zu  %9.2f %9.2f  %9.1f MiB", when, run.executed, run.up_to_date, run.failed, run.skipped, run.wall,
+                    run.cpu, run.max_rss / (1024.0 * 1024.0)
+                );
+            }
+        }
+};
+
+// The signature (see Output::signature) each output was last built with, in
+// build_dir/commands.sig — so changing a flag, or dropping an object from a
+// library, rebuilds what it affects even though no input got any newer. An output
+// with no signature on record yet (first build, or one from before this file
+// existed) takes on its current one instead of forcing a rebuild.
+class __CommandSignatures {
+    private:
+        std::unordered_map<std::string, u64> signatures_;
+        std::mutex                           mutex_;
+
+    public:
+        void load(const std::filesystem::path& path) {
+            std::ifstream file(path);
+            std::string   line;
+            while (std::getline(file, line)) {
+                usize space = line.find(' ');
+                if (space == std::string::npos) {
+                    continue;
+                }
+                u64 signature = 0;
+                std::from_chars(line.data(), line.data() + space, signature, 16);
+                signatures_[line.substr(space + 1)] = signature;
+            }
+        }
+
+        void save(const std::filesystem::path& path) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            std::ofstream               file(path, std::ios::trunc);
+            if (!file) {
+                RLOG(LL_ERROR, "Failed to open " + path.string());
+                return;
+            }
+
+            char hex[17];
+            for (const auto& [key, signature] : signatures_) {
+                snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(signature));
+                file << hex << ' ' << key << '\n';
+            }
+        }
+
+        bool changed(const std::string& key, u64 signature) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto [it, inserted] = signatures_.try_emplace(key, signature);
+            return !inserted && it->second != signature;
+        }
+
+        // Only once the output was actually rebuilt with it — a failed build has to
+        // be retried with the new command next time, not taken as up to date.
+        void record(const std::string& key, u64 signature) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            signatures_[key] = signature;
+        }
+};
+
+// What buildDAG() worked out last time, in build_dir/dag.manifest: every task's
+// dependency scan and the header-stem edges drawn from them. The scans are what
+// make a no-op run slow (one compiler -MM per Object), and neither they nor the
+// edges change unless the script, its flags or the files scanned do. Keyed by a
+// hash of all of those (see Build::manifestKey), then checked file by file: a
+// task is only scanned again if its source or something it included is newer
+// than the last scan.
+//
+// Layout, native-endian like the build history: a "BDM1" magic and a fixed
+// header, then u32 arrays — path offsets into the string table, each task's range
+// of dependencies, the dependencies as path indices, the edges as (child, parent)
+// task indices — then the string table. Mapped and used in place, never copied
+// into a buffer first.
+class __DagManifest {
+    private:
+        static constexpr char  MAGIC[4]    = {'B', 'D', 'M', '1'};
+        static constexpr usize HEADER_SIZE = 4 + 4 + 8 + 8 + 4 + 4 + 4 + 4;
+        // mtimes come from the kernel's coarse clock, up to a tick (10ms at HZ=100)
+        // behind the one scanned_at is read from — a file written just after the last
+        // scan started could otherwise look older than it. Costs one extra scan of a
+        // file saved within this long before a build.
+        static constexpr i64   SLACK_NS    = 20'000'000;
+
+        const char*     data_         = nullptr;
+        usize           size_         = 0;
+        i64             scanned_at_   = 0;
+        u32             path_count_   = 0;
+        u32             edge_count_   = 0;
+        const u32*      path_offsets_ = nullptr;
+        const u32*      dep_offsets_  = nullptr;
+        const u32*      deps_         = nullptr;
+        const u32*      edges_        = nullptr;
+        const char*     strings_      = nullptr;
+        // Per path: 0 not checked yet, 1 unchanged since the scan, 2 changed.
+        std::vector<u8> changed_;
+
+        std::string_view text(u32 path) const { return {strings_ + path_offsets_[path], path_offsets_[path + 1] - path_offsets_[path]}; }
+
+        bool changed(u32 path) {
+            if (changed_[path] == 0) {
+                std::error_code                 error;
+                std::filesystem::file_time_type time = std::filesystem::last_write_time(std::filesystem::path(text(path)), error);
+                changed_[path] = error || time.time_since_epoch().count() + SLACK_NS > scanned_at_ ? 2 : 1;
+            }
+            return changed_[path] == 2;
+        }
+
+        static void put(std::string& out, const void* data, usize size) { out.append(static_cast<const char*>(data), size); }
+
+    public:
+        __DagManifest() = default;
+        __DagManifest(const __DagManifest&) = delete;
+        __DagManifest& operator=(const __DagManifest&) = delete;
+
+        ~__DagManifest() {
+            if (data_ != nullptr) {
+                munmap(const_cast<char*>(data_), size_);
+            }
+        }
+
+        // False — and nothing cached — unless the file is there, intact, and was
+        // written for this key and this many tasks.
+        bool load(const std::filesystem::path& path, u64 key, u32 task_count) {
+            i32 fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0) {
+                return false;
+            }
+            struct stat info;
+            if (fstat(fd, &info) != 0 || static_cast<usize>(info.st_size) < HEADER_SIZE) {
+                close(fd);
+                return false;
+            }
+            size_        = static_cast<usize>(info.st_size);
+            void* mapped = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            close(fd);
+            if (mapped == MAP_FAILED) {
+                return false;
+            }
+            data_ = static_cast<const char*>(mapped);
+
+            u32 stored_tasks, dep_count, string_bytes;
+            u64 stored_key;
+            memcpy(&stored_tasks, data_ + 4, 4);
+            memcpy(&stored_key, data_ + 8, 8);
+            memcpy(&scanned_at_, data_ + 16, 8);
+            memcpy(&path_count_, data_ + 24, 4);
+            memcpy(&dep_count, data_ + 28, 4);
+            memcpy(&edge_count_, data_ + 32, 4);
+            memcpy(&string_bytes, data_ + 36, 4);
+            if (memcmp(data_, MAGIC, sizeof(MAGIC)) != 0 || stored_key != key || stored_tasks != task_count) {
+                return false;
+            }
+
+            u64 words = u64{path_count_} + 1 + task_count + 1 + dep_count + u64{edge_count_} * 2;
+            if (HEADER_SIZE + words * 4 + string_bytes != size_) {
+                return false;
+            }
+            path_offsets_ = reinterpret_cast<const u32*>(data_ + HEADER_SIZE);
+            dep_offsets_  = path_offsets_ + path_count_ + 1;
+            deps_         = dep_offsets_ + task_count + 1;
+            edges_        = deps_ + dep_count;
+            strings_      = reinterpret_cast<const char*>(edges_ + u64{edge_count_} * 2);
+
+            // Everything below indexes by these, so a bad one anywhere (a torn or
+            // hand-edited file) rejects the whole manifest here instead.
+            bool valid = path_offsets_[0] == 0 && path_offsets_[path_count_] == string_bytes && dep_offsets_[0] == 0
+                      && dep_offsets_[task_count] == dep_count;
+            for (u32 i = 0; valid && i < path_count_; ++i) {
+                valid = path_offsets_[i] <= path_offsets_[i + 1];
+            }
+            for (u32 i = 0; valid && i < task_count; ++i) {
+                valid = dep_offsets_[i] <= dep_offsets_[i + 1];
+            }
+            for (u32 i = 0; valid && i < dep_count; ++i) {
+                valid = deps_[i] < path_count_;
+            }
+            for (u64 i = 0; valid && i < u64{edge_count_} * 2; ++i) {
+                valid = edges_[i] < task_count;
+            }
+            if (!valid) {
+                return false;
+            }
+
+            changed_.assign(path_count_, 0);
+            return true;
+        }
+
+        // The task's last scan, or nullopt if it has to be scanned again. An Object
+        // whose last scan came back empty always is — that's a scan that failed (a
+        // header a Command hadn't generated yet, say), not a source with no inputs.
+        std::optional<std::vector<std::filesystem::path>> dependencies(u32 task, bool object) {
+            if (data_ == nullptr || changed_.empty()) {
+                return std::nullopt;
+            }
+            if (object && dep_offsets_[task] == dep_offsets_[task + 1]) {
+                return std::nullopt;
+            }
+
+            std::vector<std::filesystem::path> dependencies;
+            dependencies.reserve(dep_offsets_[task + 1] - dep_offsets_[task]);
+            for (u32 i = dep_offsets_[task]; i < dep_offsets_[task + 1]; ++i) {
+                if (changed(deps_[i])) {
+                    return std::nullopt;
+                }
+                dependencies.emplace_back(text(deps_[i]));
+            }
+            return dependencies;
+        }
+
+        std::span<const u32> edges() const { return {edges_, u64{edge_count_} * 2}; }
+
+        // Temp file plus rename, so a run killed mid-write leaves the old manifest
+        // (or none), never a torn one that happens to pass load()'s checks.
+        static void save(const std::filesystem::path& path, u64 key, i64 scanned_at, const std::vector<std::vector<std::filesystem::path>>& dependencies,
+                         const std::vector<std::pair<u32, u32>>& edges) {
+            std::unordered_map<std::string_view, u32> indices;
+            std::vector<u32>                          path_offsets = {0};
+            std::vector<u32>                          dep_offsets  = {0};
+            std::vector<u32>                          deps;
+            std::string                               strings;
+
+            for (const auto& task_dependencies : dependencies) {
+                for (const auto& dependency : task_dependencies) {
+                    auto [it, inserted] = indices.try_emplace(dependency.native(), static_cast<u32>(indices.size()));
+                    if (inserted) {
+                        strings += dependency.native();
+                        path_offsets.push_back(static_cast<u32>(strings.size()));
+                    }
+                    deps.push_back(it->second);
+                }
+                dep_offsets.push_back(static_cast<u32>(deps.size()));
+            }
+
+            u32 task_count   = static_cast<u32>(dependencies.size());
+            u32 path_count   = static_cast<u32>(indices.size());
+            u32 dep_count    = static_cast<u32>(deps.size());
+            u32 edge_count   = static_cast<u32>(edges.size());
+            u32 string_bytes = static_cast<u32>(strings.size());
+
+            std::string out;
+            put(out, MAGIC, sizeof(MAGIC));
+            put(out, &task_count, 4);
+            put(out, &key, 8);
+            put(out, &scanned_at, 8);
+            put(out, &path_count, 4);
+            put(out, &dep_count, 4);
+            put(out, &edge_count, 4);
+            put(out, &string_bytes, 4);
+            put(out, path_offsets.data(), path_offsets.size() * 4);
+            put(out, dep_offsets.data(), dep_offsets.size() * 4);
+            put(out, deps.data(), deps.size() * 4);
+            for (const auto& [child, parent] : edges) {
+                put(out, &child, 4);
+                put(out, &parent, 4);
+            }
+            out += strings;
+
+            std::filesystem::path temporary = path;
+            temporary += ".tmp";
+            std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+            file.write(out.data(), static_cast<std::streamsize>(out.size()));
+            file.close();
+
+            std::error_code error;
+            if (!file) {
+                RLOG(LL_ERROR, "Failed to write " + temporary.string());
+                return;
+            }
+            std::filesystem::rename(temporary, path, error);
+            if (error) {
+                RLOG(LL_ERROR, "Failed to write " + path.string() + ": " + error.message());
+            }
+        }
+};
+
+// Just enough JSON to walk clang's -ftime-trace output: strings, numbers, and
+// skipping whatever else is in the way. Malformed input stops the walk (ok() goes
+// false) rather than throwing — one truncated trace shouldn't lose the whole report.
+class __JsonReader {
+    private:
+        std::string_view text_;
+        usize            pos_ = 0;
+        bool             ok_  = true;
+
+        void skipSpace() {
+            while (pos_ < text_.size() && std::isspace(static_cast<unsigned char>(text_[pos_]))) {
+                ++pos_;
+            }
+        }
+
+    public:
+        explicit __JsonReader(std::string_view text) : text_(text) {}
+
+        bool ok() const { return ok_; }
+
+        // Consumes c if it's next, skipping whitespace either side.
+        bool consume(char c) {
+            skipSpace();
+            if (pos_ < text_.size() && text_[pos_] == c) {
+                ++pos_;
+                skipSpace();
+                return true;
+            }
+            return false;
+        }
+
+        void expect(char c) {
+            if (!consume(c)) {
+                ok_ = false;
+            }
+        }
+
+        char peek() {
+            skipSpace();
+            return pos_ < text_.size() ? text_[pos_] : '\0';
+        }
+
+        // \u escapes outside ASCII come back as '?' — names and paths only ever get
+        // compared against each other and printed.
+        std::string string() {
+            std::string value;
+            expect('"');
+            while (ok_ && pos_ < text_.size() && text_[pos_] != '"') {
+                char c = text_[pos_++];
+                if (c == '\\' && pos_ < text_.size()) {
+                    char escaped = text_[pos_++];
+                    switch (escaped) {
+                        case 'n': value += '\n'; break;
+                        case 't': value += '\t'; break;
+                        case 'r': value += '\r'; break;
+                        case 'b': value += '\b'; break;
+                        case 'f': value += '\f'; break;
+                        case 'u': {
+                            u32 code = 0;
+                            std::from_chars(text_.data() + pos_, text_.data() + std::min(pos_ + 4, text_.size()), code, 16);
+                            value += code < 0x80 ? static_cast<char>(code) : '?';
+                            pos_ += 4;
+                            break;
+                        }
+                        default: value += escaped; break;
+                    }
+                } else {
+                    value += c;
+                }
+            }
+            if (pos_ >= text_.size()) {
+                ok_ = false;
+            }
+            ++pos_;
+            return value;
+        }
+
+        f64 number() {
+            skipSpace();
+            f64   value = 0.0;
+            auto  [end, error] = std::from_chars(text_.data() + pos_, text_.data() + text_.size(), value);
+            if (error != std::errc()) {
+                ok_ = false;
+                return 0.0;
+            }
+            pos_ = static_cast<usize>(end - text_.data());
+            return value;
+        }
+
+        void skip() {
+            char c = peek();
+            if (c == '"') {
+                string();
+            } else if (c == '{' || c == '[') {
+                char close = c == '{' ? '}' : ']';
+                ++pos_;
+                if (consume(close)) {
+                    return;
+                }
+                do {
+                    if (c == '{') {
+                        string();
+                        expect(':');
+                    }
+                    skip();
+                } while (ok_ && consume(','));
+                expect(close);
+            } else if (c == '-' || std::isdigit(static_cast<unsigned char>(c))) {
+                number();
+            } else if (text_.substr(pos_).starts_with("true") || text_.substr(pos_).starts_with("null")) {
+                pos_ += 4;
+            } else if (text_.substr(pos_).starts_with("false")) {
+                pos_ += 5;
+            } else {
+                ok_ = false;
+            }
+        }
+};
+
+// --time-trace: every Object compile also writes clang's -ftime-trace JSON next to
+// its object file, and once the build is done they're all summed up here — the same
+// idea as ClangBuildAnalyzer, without a separate tool or capture step. Header times
+// are inclusive (a header's own parse plus everything it includes), summed across
+// every TU that included it: that's what removing or slimming that one #include
+// would save.
+class __TimeTraceReport {
+    private:
+        struct Entry {
+                f64   total_ms = 0.0;
+                f64   max_ms   = 0.0;
+                usize count    = 0;
+        };
+
+        std::unordered_map<std::string, Entry> headers_;
+        std::unordered_map<std::string, Entry> instantiations_;
+        std::unordered_map<std::string, Entry> functions_;
+        usize                                  traces_ = 0;
+        f64                                    frontend_ms_ = 0.0;
+        f64                                    backend_ms_  = 0.0;
+
+        static void add(std::unordered_map<std::string, Entry>& into, std::string key, f64 ms) {
+            Entry& entry   = into[std::move(key)];
+            entry.total_ms += ms;
+            entry.max_ms   = std::max(entry.max_ms, ms);
+            ++entry.count;
+        }
+
+        static void print(const char* title, const std::unordered_map<std::string, Entry>& entries, usize top) {
+            std::vector<std::pair<std::string, Entry>> ranked(entries.begin(), entries.end());
+            std::sort(ranked.begin(), ranked.end(), [](const auto& a, const auto& b) { return a.second.total_ms > b.second.total_ms; });
+
+            RLOG(LL_INFO, "%s (total / max ms, count):", title);
+            for (usize i = 0; i < std::min(top, ranked.size()); ++i) {
+                const auto& [key, entry] = ranked[i];
+                RLOG(LL_INFO, "  %10.1f %8.1f %6zu  %s", entry.total_ms, entry.max_ms, entry.count, key.c_str());
+            }
+        }
+
+    public:
+        // Where clang puts the trace for a given -o: same path, .json extension.
+        static std::filesystem::path tracePathFor(const std::filesystem::path& object) {
+            std::filesystem::path path = object;
+            path.replace_extension(".json");
+            return path;
+        }
+
+        // Returns false if the trace is missing or couldn't be read to the end.
+        bool add(const std::filesystem::path& path) {
+            std::ifstream file(path, std::ios::binary);
+            if (!file) {
+                return false;
+            }
+            std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+            __JsonReader json(text);
+            json.expect('{');
+            while (json.ok() && json.peek() == '"') {
+                std::string key = json.string();
+                json.expect(':');
+                if (key != "traceEvents") {
+                    json.skip();
+                    json.consume(',');
+                    continue;
+                }
+
+                json.expect('[');
+                while (json.ok() && json.peek() == '{') {
+                    std::string name, detail;
+                    f64         duration_us = 0.0;
+                    json.expect('{');
+                    while (json.ok() && json.peek() == '"') {
+                        std::string field = json.string();
+                        json.expect(':');
+                        if (field == "name") {
+                            name = json.string();
+                        } else if (field == "dur") {
+                            duration_us = json.number();
+                        } else if (field == "args" && json.peek() == '{') {
+                            json.expect('{');
+                            while (json.ok() && json.peek() == '"') {
+                                std::string arg = json.string();
+                                json.expect(':');
+                                if (arg == "detail" && json.peek() == '"') {
+                                    detail = json.string();
+                                } else {
+                                    json.skip();
+                                }
+                                json.consume(',');
+                            }
+                            json.expect('}');
+                        } else {
+                            json.skip();
+                        }
+                        json.consume(',');
+                    }
+                    json.expect('}');
+                    json.consume(',');
+
+                    f64 ms = duration_us / 1000.0;
+                    if (name == "Source") {
+                        add(headers_, std::move(detail), ms);
+                    } else if (name == "InstantiateClass" || name == "InstantiateFunction") {
+                        add(instantiations_, std::move(detail), ms);
+                    } else if (name == "OptFunction") {
+                        add(functions_, std::move(detail), ms);
+                    } else if (name == "Total Frontend") {
+                        frontend_ms_ += ms;
+                    } else if (name == "Total Backend") {
+                        backend_ms_ += ms;
+                    }
+                }
+                json.expect(']');
+                json.consume(',');
+            }
+
+            if (!json.ok()) {
+                RLOG(LL_WARN, "Couldn't parse time trace " + path.string());
+                return false;
+            }
+            ++traces_;
+            return true;
+        }
+
+        void report(usize top = 10) const {
+            if (traces_ == 0) {
+                RLOG(LL_WARN, "No -ftime-trace output found — --time-trace needs a compiler that supports it (clang)");
+                return;
+            }
+
+            RLOG(LL_INFO, "Time trace: %zu translation units, %.1f s frontend, %.1f s backend", traces_, frontend_ms_ / 1000.0, backend_ms_ / 1000.0);
+            print("Most expensive headers to include", headers_, top);
+            print("Most expensive template instantiations", instantiations_, top);
+            print("Slowest functions to optimize", functions_, top);
+        }
+};
+
+inline std::string __jsonEscape(std::string_view text) {
+    std::string escaped;
+    escaped.reserve(text.size());
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+            escaped += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char code[8];
+            snprintf(code, sizeof(code), "\\u%04x", c);
+            escaped += code;
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+// --trace out.json: Chrome trace-event JSON, which chrome://tracing and Perfetto both
+// load. Every thread that records anything gets its own track — "main" for the
+// build's own phases, "worker N" for the pool — and counters get tracks of their own.
+// Events are buffered in memory and only written once the build is over, so
+// recording one is a lock and a push_back; while disabled, it's a single branch.
+class __TraceRecorder {
+    private:
+        struct Event {
+                std::string name;
+                const char* category;
+                char        phase;
+                i64         start_ns;
+                i64         duration_ns;
+                u32         tid;
+                std::string args;
+        };
+
+        bool                                        enabled_ = false;
+        i64                                         origin_ns_ = 0;
+        std::mutex                                  mutex_;
+        std::vector<Event>                          events_;
+        std::vector<std::pair<u32, std::string>>    thread_names_;
+        std::atomic<u32>                            next_worker_ = 0;
+        static inline thread_local u32              tid_ = 0;
+
+        // Tracks are numbered as threads first record something: the thread that
+        // enabled tracing is "main", every other one a worker.
+        u32 threadId() {
+            if (tid_ == 0) {
+                u32 worker = next_worker_.fetch_add(1);
+                tid_       = worker + 2;
+
+                std::lock_guard<std::mutex> lock(mutex_);
+                thread_names_.emplace_back(tid_, "worker " + std::to_string(worker));
+            }
+            return tid_;
+        }
+
+        void push(Event event) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            events_.push_back(std::move(event));
+        }
+
+    public:
+        static i64 now() { return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count(); }
+
+        void enable() {
+            enabled_   = true;
+            origin_ns_ = now();
+            tid_       = 1;
+            thread_names_.emplace_back(1, "main");
+        }
+
+        bool enabled() const { return enabled_; }
+
+        // A complete ("X") event on the calling thread's track. args, if any, is the
+        // body of a JSON object: "\"key\": value, ...".
+        void slice(std::string name, const char* category, i64 start_ns, i64 end_ns, std::string args = "") {
+            if (enabled_) {
+                push(Event{std::move(name), category, 'X', start_ns, end_ns - start_ns, threadId(), std::move(args)});
+            }
+        }
+
+        // A sample on the counter track called name.
+        void counter(const char* name, i64 value) {
+            if (enabled_) {
+                push(Event{name, "counter", 'C', now(), 0, 0, "\"value\": " + std::to_string(value)});
+            }
+        }
+
+        void write(const std::filesystem::path& path) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            std::ofstream               file(path);
+            if (!file) {
+                RLOG(LL_ERROR, "Failed to open " + path.string());
+                return;
+            }
+
+            file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+            file << "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"args\": {\"name\": \"build\"}}";
+            for (const auto& [tid, name] : thread_names_) {
+                file << ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << tid << ", \"args\": {\"name\": \"" << name << "\"}}";
+            }
+
+            char timestamps[64];
+            for (const Event& event : events_) {
+                file << ",\n{\"name\": \"" << __jsonEscape(event.name) << "\", \"cat\": \"" << event.category << "\", \"ph\": \"" << event.phase << "\", ";
+                if (event.phase == 'X') {
+                    snprintf(timestamps, sizeof(timestamps), "\"ts\": %.3f, \"dur\": %.3f", (event.start_ns - origin_ns_) / 1e3, event.duration_ns / 1e3);
+                } else {
+                    snprintf(timestamps, sizeof(timestamps), "\"ts\": %.3f", (event.start_ns - origin_ns_) / 1e3);
+                }
+                file << timestamps << ", \"pid\": 1, \"tid\": " << event.tid << ", \"args\": {" << event.args << "}}";
+            }
+            file << "\n]}\n";
+
+            RLOG(LL_INFO, "Trace written to " + path.string() + " (" + std::to_string(events_.size()) + " events)");
+        }
+};
+
+// Records a slice covering its own lifetime.
+class __TraceScope {
+    private:
+        __TraceRecorder& recorder_;
+        std::string      name_;
+        const char*      category_;
+        i64              start_ns_;
+
+    public:
+        __TraceScope(__TraceRecorder& recorder, std::string name, const char* category)
+            : recorder_(recorder), name_(recorder.enabled() ? std::move(name) : std::string()), category_(category),
+              start_ns_(recorder.enabled() ? __TraceRecorder::now() : 0) {}
+
+        ~__TraceScope() { recorder_.slice(std::move(name_), category_, start_ns_, __TraceRecorder::now()); }
+
+        __TraceScope(const __TraceScope&)            = delete;
+        __TraceScope& operator=(const __TraceScope&) = delete;
+};
+
+// --metrics out.prom: a Prometheus text-format file for node_exporter's textfile collector
+// (point --collector.textfile.directory at its directory). Counts are for this run
+// only — the file is replaced whole at the end of every build, through a rename so
+// the collector never scrapes a half-written one.
+class __BuildMetrics {
+    private:
+        static constexpr f64 DURATION_BUCKETS[] = {0.1, 0.5, 1.0, 2.5, 5.0, 10.0, 30.0, 60.0, 120.0, 300.0};
+        static constexpr f64 WAIT_BUCKETS[]     = {0.001, 0.01, 0.1, 0.5, 1.0, 5.0, 30.0};
+
+        template <usize N>
+        struct Histogram {
+                std::array<u64, N> counts = {};
+                f64                sum    = 0.0;
+                u64                count  = 0;
+
+                void observe(const f64 (&bounds)[N], f64 value) {
+                    for (usize i = 0; i < N; ++i) {
+                        counts[i] += value <= bounds[i];
+                    }
+                    sum += value;
+                    ++count;
+                }
+        };
+
+        struct Series {
+                std::array<u64, 4>                          outcomes = {};
+                Histogram<std::size(DURATION_BUCKETS)>      duration;
+                Histogram<std::size(WAIT_BUCKETS)>          queue_wait;
+        };
+
+        bool                                                enabled_ = false;
+        std::mutex                                          mutex_;
+        // std::map, so the file comes out in the same order every run.
+        std::map<std::pair<std::string, TaskKind>, Series>  series_;
+        std::map<std::string, f64>                          phases_;
+        i64                                                 peak_running_ = 0;
+
+        static std::string labels(const std::pair<std::string, TaskKind>& key) {
+            std::string escaped;
+            for (char c : key.first) {
+                if (c == '"' || c == '\\') {
+                    escaped += '\\';
+                }
+                escaped += c == '\n' ? ' ' : c;
+            }
+            return "group=\"" + escaped + "\",kind=\"" + __taskKindName(key.second) + "\"";
+        }
+
+        // Shortest round-trip form, but always with a decimal point — "1.0", not "1" —
+        // so a bucket's le label is spelled the same way whatever writes it.
+        static std::string bound(f64 value) {
+            char        buffer[32];
+            char*       end = std::to_chars(buffer, buffer + sizeof(buffer), value).ptr;
+            std::string text(buffer, end);
+            if (text.find_first_of(".e") == std::string::npos) {
+                text += ".0";
+            }
+            return text;
+        }
+
+        template <usize N>
+        static void writeHistogram(std::ostream& out, const char* name, const std::string& labels, const Histogram<N>& histogram, const f64 (&bounds)[N]) {
+            for (usize i = 0; i < N; ++i) {
+                out << name << "_bucket{" << labels << ",le=\"" << bound(bounds[i]) << "\"} " << histogram.counts[i] << "\n";
+            }
+            out << name << "_bucket{" << labels << ",le=\"+Inf\"} " << histogram.count << "\n";
+            out << name << "_sum{" << labels << "} " << histogram.sum << "\n";
+            out << name << "_count{" << labels << "} " << histogram.count << "\n";
+        }
+
+    public:
+        void enable() { enabled_ = true; }
+
+        bool enabled() const { return enabled_; }
+
+        // wall_seconds only counts towards the duration histogram for tasks that
+        // actually executed (or failed) — an up-to-date check isn't a compile.
+        void recordTask(const std::string& group, TaskKind kind, TaskOutcome outcome, f64 wall_seconds, f64 queue_wait_seconds) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            Series& series = series_[{group, kind}];
+            ++series.outcomes[static_cast<u8>(outcome)];
+            if (outcome == TaskOutcome::Executed || outcome == TaskOutcome::Failed) {
+                series.duration.observe(DURATION_BUCKETS, wall_seconds);
+            }
+            series.queue_wait.observe(WAIT_BUCKETS, queue_wait_seconds);
+        }
+
+        // Summed by name, so e.g. repeated dispatches add up.
+        void recordPhase(const std::string& phase, f64 seconds) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            phases_[phase] += seconds;
+        }
+
+        void observeRunning(i64 running) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            peak_running_ = std::max(peak_running_, running);
+        }
+
+        void write(const std::filesystem::path& path, usize failures) {
+            static constexpr const char* OUTCOMES[] = {"executed", "up_to_date", "failed", "skipped"};
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            std::filesystem::path       temporary = path;
+            temporary += ".tmp." + std::to_string(getpid());
+            {
+                std::ofstream out(temporary);
+                if (!out) {
+                    RLOG(LL_ERROR, "Failed to open " + temporary.string());
+                    return;
+                }
+
+                out << "# TYPE build_tasks_total counter\n";
+                out << "# HELP build_tasks_total Tasks finished this run, by outcome. up_to_date is a hit on the previous build's outputs.\n";
+                for (const auto& [key, series] : series_) {
+                    for (usize i = 0; i < series.outcomes.size(); ++i) {
+                        out << "build_tasks_total{" << labels(key) << ",outcome=\"" << OUTCOMES[i] << "\"} " << series.outcomes[i] << "\n";
+                    }
+                }
+
+                out << "# TYPE build_task_duration_seconds histogram\n";
+                out << "# HELP build_task_duration_seconds Wall time of each task that ran.\n";
+                for (const auto& [key, series] : series_) {
+                    writeHistogram(out, "build_task_duration_seconds", labels(key), series.duration, DURATION_BUCKETS);
+                }
+
+                out << "# TYPE build_task_queue_wait_seconds histogram\n";
+                out << "# HELP build_task_queue_wait_seconds Time from a task becoming ready to a worker starting it.\n";
+                for (const auto& [key, series] : series_) {
+                    writeHistogram(out, "build_task_queue_wait_seconds", labels(key), series.queue_wait, WAIT_BUCKETS);
+                }
+
+                out << "# TYPE build_phase_duration_seconds gauge\n";
+                out << "# HELP build_phase_duration_seconds Wall time of each phase of the run.\n";
+                for (const auto& [phase, seconds] : phases_) {
+                    out << "build_phase_duration_seconds{phase=\"" << phase << "\"} " << seconds << "\n";
+                }
+
+                out << "# TYPE build_peak_running_tasks gauge\n";
+                out << "# HELP build_peak_running_tasks Most tasks executing at once.\n";
+                out << "build_peak_running_tasks " << peak_running_ << "\n";
+
+                out << "# TYPE build_failures gauge\n";
+                out << "# HELP build_failures Tasks that failed this run.\n";
+                out << "build_failures " << failures << "\n";
+
+                out << "# TYPE build_last_run_timestamp_seconds gauge\n";
+                out << "build_last_run_timestamp_seconds " << std::time(nullptr) << "\n";
+
+                if (!out.flush()) {
+                    RLOG(LL_ERROR, "Failed to write " + temporary.string());
+                    std::filesystem::remove(temporary);
+                    return;
+                }
+            }
+
+            std::error_code error;
+            std::filesystem::rename(temporary, path, error);
+            if (error) {
+                RLOG(LL_ERROR, "Failed to replace " + path.string() + ": " + error.message());
+                std::filesystem::remove(temporary);
+            }
+        }
+};
+
+// The "[done/total] running ... ETA" line pinned under the log on a terminal (see
+// __Log_status). The ETA is the larger of what's left of the critical path and the
+// remaining estimated work spread over every job, both from the same per-task
+// estimates that rank the ready queue — so it starts out pessimistic on an
+// incremental build and catches up as up-to-date tasks finish instantly.
+class __BuildProgress {
+    private:
+        static constexpr i64 REDRAW_NS = 100'000'000;
+
+        enum : u8 { PENDING, RUNNING, DONE };
+
+        bool                enabled_ = false;
+        std::mutex          mutex_;
+        const TaskGraph*    graph_   = nullptr;
+        std::vector<f64>    estimates_;
+        std::vector<u8>     state_;
+        std::vector<i64>    started_ns_;
+        std::vector<u32>    running_;
+        usize               done_    = 0;
+        usize               total_   = 0;
+        f64                 remaining_work_ = 0.0;
+        i32                 jobs_    = 1;
+        i64                 last_draw_ns_ = 0;
+
+        static std::string formatSeconds(f64 seconds) {
+            u64  whole = static_cast<u64>(std::max(0.0, seconds) + 0.5);
+            char text[32];
+            if (whole >= 60) {
+                snprintf(text, sizeof(text), "%llum%02llus", static_cast<unsigned long long>(whole / 60), static_cast<unsigned long long>(whole % 60));
+            } else {
+                snprintf(text, sizeof(text), "%llus", static_cast<unsigned long long>(whole));
+            }
+            return text;
+        }
+
+        f64 eta(i64 now) const {
+            f64 critical = 0.0;
+            for (usize i = 0; i < state_.size(); ++i) {
+                if (state_[i] == PENDING) {
+                    critical = std::max(critical, graph_->priority(static_cast<u32>(i)));
+                } else if (state_[i] == RUNNING) {
+                    // Overrunning its estimate doesn't make the rest of the path shorter.
+                    f64 elapsed = std::min((now - started_ns_[i]) / 1e9, estimates_[i]);
+                    critical    = std::max(critical, graph_->priority(static_cast<u32>(i)) - elapsed);
+                }
+            }
+            return std::max(critical, remaining_work_ / jobs_);
+        }
+
+        void draw(i64 now) {
+            last_draw_ns_ = now;
+
+            std::string line = "[" + std::to_string(done_) + "/" + std::to_string(total_) + "]";
+            if (!running_.empty()) {
+                line += " " + std::to_string(running_.size()) + " running: ";
+                for (usize i = 0; i < running_.size(); ++i) {
+                    line += (i > 0 ? ", " : "") + graph_->task(running_[i])->sourcePath().filename().string();
+                }
+            }
+            std::string eta_text = "  ETA " + formatSeconds(eta(now));
+
+            winsize size{};
+            usize   width = ioctl(STDERR_FILENO, TIOCGWINSZ, &size) == 0 && size.ws_col > 0 ? size.ws_col : 80;
+            // One column spare: a line that exactly fills the terminal wraps the cursor
+            // onto the next row on some terminals, and the erase would miss it.
+            usize room = width > eta_text.size() + 1 ? width - eta_text.size() - 1 : 0;
+            if (line.size() > room) {
+                line.resize(room > 3 ? room - 3 : 0);
+                line += room > 3 ? "..." : "";
+            }
+            __Log_status((line + eta_text).c_str());
+        }
+
+    public:
+        // Only ever on a terminal — piped into a file or CI log, the plain per-task
+        // lines are all there is.
+        void enable() { enabled_ = isatty(STDERR_FILENO) != 0; }
+
+        bool enabled() const { return enabled_; }
+
+        // estimates: seconds per task id. Tasks this shard doesn't run aren't counted.
+        void begin(const TaskGraph& graph, std::vector<f64> estimates, i32 jobs) {
+            if (!enabled_) {
+                return;
+            }
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            graph_          = &graph;
+            estimates_      = std::move(estimates);
+            jobs_           = std::max(1, jobs);
+            state_.assign(graph.size(), PENDING);
+            started_ns_.assign(graph.size(), 0);
+            running_.clear();
+            done_           = 0;
+            total_          = 0;
+            remaining_work_ = 0.0;
+            for (u32 id = 0; id < graph.size(); ++id) {
+                if (graph.task(id)->excluded()) {
+                    state_[id] = DONE;
+                } else {
+                    ++total_;
+                    remaining_work_ += estimates_[id];
+                }
+            }
+            draw(__TraceRecorder::now());
+        }
+
+        void started(u32 id) {
+            if (!enabled_) {
+                return;
+            }
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (state_[id] != PENDING) {
+                return;
+            }
+            i64 now         = __TraceRecorder::now();
+            state_[id]      = RUNNING;
+            started_ns_[id] = now;
+            running_.push_back(id);
+            if (now - last_draw_ns_ >= REDRAW_NS) {
+                draw(now);
+            }
+        }
+
+        void finished(u32 id) {
+            if (!enabled_) {
+                return;
+            }
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (state_[id] != RUNNING) {
+                return;
+            }
+            state_[id] = DONE;
+            std::erase(running_, id);
+            remaining_work_ = std::max(0.0, remaining_work_ - estimates_[id]);
+            ++done_;
+
+            i64 now = __TraceRecorder::now();
+            if (now - last_draw_ns_ >= REDRAW_NS || done_ == total_) {
+                draw(now);
+            }
+        }
+
+        void end() {
+            if (enabled_) {
+                __Log_status(nullptr);
+            }
+        }
+};
+
+// --explain: logs why every stale task is being rebuilt as needsRebuild() works it
+// out, and traces each one back to the task whose own change started the cascade —
+// the summary at the end ranks those root causes by how many rebuilds they caused.
+class __RebuildExplainer {
+    private:
+        bool                     enabled_ = false;
+        std::mutex               mutex_;
+        std::vector<std::string> reasons_;
+        std::vector<u32>         roots_;
+
+    public:
+        void enable() { enabled_ = true; }
+
+        bool enabled() const { return enabled_; }
+
+        void begin(usize task_count) {
+            reasons_.assign(task_count, "");
+            roots_.assign(task_count, UINT32_MAX);
+        }
+
+        // root is the id of the task whose own reason this rebuild traces back to —
+        // id itself, unless it's only stale because a parent is.
+        void record(const Task& task, u32 id, std::string reason, u32 root) {
+            if (!enabled_) {
+                return;
+            }
+
+            RLOG(LL_INFO, "Rebuilding " + task.sourcePath().string() + ": " + reason);
+            std::lock_guard<std::mutex> lock(mutex_);
+            reasons_[id] = std::move(reason);
+            roots_[id]   = root;
+        }
+
+        u32 root(u32 id) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return roots_[id];
+        }
+
+        void report(const TaskGraph& graph, usize top = 10) {
+            if (!enabled_) {
+                return;
+            }
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            std::unordered_map<u32, usize> fan_out;
+            for (u32 root : roots_) {
+                if (root != UINT32_MAX) {
+                    ++fan_out[root];
+                }
+            }
+            if (fan_out.empty()) {
+                RLOG(LL_INFO, "Nothing to rebuild");
+                return;
+            }
+
+            std::vector<std::pair<u32, usize>> ranked(fan_out.begin(), fan_out.end());
+            std::sort(ranked.begin(), ranked.end(), [](const auto& a, const auto& b) { return a.second > b.second; });
+
+            RLOG(LL_INFO, "Root causes (tasks rebuilt because of each):");
+            for (usize i = 0; i < std::min(top, ranked.size()); ++i) {
+                const auto& [root, count] = ranked[i];
+                RLOG(LL_INFO, "  %6zu  %s: %s", count, graph.task(root)->sourcePath().string().c_str(), reasons_[root].c_str());
+            }
+        }
+};
+
+struct __TaskPriorityLess {
+        bool operator()(const Task* a, const Task* b) const;
+};
+
+// Chase–Lev work-stealing deque (the weak-memory-model formulation from Lê et al.,
+// "Correct and Efficient Work-Stealing for Weak Memory Models"). Only the owning
+// worker ever push()es or pop()s, at the bottom; any other worker may steal() from
+// the top. T must be trivially copyable — T{} doubles as "nothing there".
+template <typename T>
+class __WorkStealingDeque {
+    private:
+        struct Buffer {
+                i64                             capacity;
+                std::unique_ptr<std::atomic<T>[]> slots;
+
+                explicit Buffer(i64 capacity) : capacity(capacity), slots(new std::atomic<T>[capacity]) {}
+
+                T get(i64 index) const { return slots[index & (capacity - 1)].load(std::memory_order_relaxed); }
+
+                void put(i64 index, T value) { slots[index & (capacity - 1)].store(value, std::memory_order_relaxed); }
+        };
+
+        std::atomic<i64>     top_;
+        std::atomic<i64>     bottom_;
+        std::atomic<Buffer*> buffer_;
+        // A thief can still be reading an outgrown buffer, so they're only freed with
+        // the deque itself — at most log2(peak size) of them, all smaller than the
+        // live one.
+        std::vector<std::unique_ptr<Buffer>> retired_;
+
+    public:
+        explicit __WorkStealingDeque(i64 capacity = 64) : top_(0), bottom_(0), buffer_(new Buffer(capacity)) {}
+
+        ~__WorkStealingDeque() { delete buffer_.load(); }
+
+        __WorkStealingDeque(const __WorkStealingDeque&)            = delete;
+        __WorkStealingDeque& operator=(const __WorkStealingDeque&) = delete;
+
+        void push(T value) {
+            i64     bottom = bottom_.load(std::memory_order_relaxed);
+            i64     top    = top_.load(std::memory_order_acquire);
+            Buffer* buffer = buffer_.load(std::memory_order_relaxed);
+
+            if (bottom - top > buffer->capacity - 1) {
+                Buffer* grown = new Buffer(buffer->capacity * 2);
+                for (i64 i = top; i < bottom; ++i) {
+                    grown->put(i, buffer->get(i));
+                }
+                retired_.emplace_back(buffer);
+                buffer_.store(grown, std::memory_order_release);
+                buffer = grown;
+            }
+
+            buffer->put(bottom, value);
+            std::atomic_thread_fence(std::memory_order_release);
+            bottom_.store(bottom + 1, std::memory_order_relaxed);
+        }
+
+        T pop() {
+            i64     bottom = bottom_.load(std::memory_order_relaxed) - 1;
+            Buffer* buffer = buffer_.load(std::memory_order_relaxed);
+            bottom_.store(bottom, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            i64 top = top_.load(std::memory_order_relaxed);
+
+            if (top > bottom) {
+                bottom_.store(bottom + 1, std::memory_order_relaxed);
+                return T{};
+            }
+
+            T value = buffer->get(bottom);
+            if (top == bottom) {
+                // Last element: race any thief for it through top_.
+                if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                    value = T{};
+                }
+                bottom_.store(bottom + 1, std::memory_order_relaxed);
             }
-            return paths;
+            return value;
         }
 
-        std::string& compiler() { return *compiler_; }
-
-        const std::vector<std::string>& compileFlags() { return compile_flags_; }
+        T steal() {
+            i64 top = top_.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            i64 bottom = bottom_.load(std::memory_order_acquire);
 
-        const std::vector<std::string>& linkFlags() { return link_flags_; }
+            if (top >= bottom) {
+                return T{};
+            }
 
-        std::vector<std::string> linkables() {
-            std::vector<std::string> result;
-            for (auto& link : links_) {
-                result.push_back(std::visit([](const auto& l) { return l.linkable(); }, link));
+            T value = buffer_.load(std::memory_order_acquire)->get(top);
+            if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                return T{};
             }
-            return result;
+            return value;
         }
 };
 
@@ -1411,41 +4133,227 @@ class ThreadPool {
         static constexpr i32 DEFAULT_THREAD_COUNT = 4;
 
     private:
-        Build*                    build_ = nullptr;
-        std::vector<std::thread> threads_;
-        std::queue<Task*>        work_queue_;
+        std::function<void(Task*)> runner_;
+        std::vector<std::thread>   threads_;
+        // One per worker. The most critical child a worker's own task just unblocked
+        // goes on its own deque, no lock involved; idle workers steal from the others'.
+        std::vector<std::unique_ptr<__WorkStealingDeque<Task*>>> deques_;
+        // Injection queue, for the dispatch's roots and a fan-out's remaining siblings.
+        // Max-heap on Task::priority(): a long compile on the critical path goes out
+        // ahead of however many short ones happened to become ready first.
+        std::priority_queue<Task*, std::vector<Task*>, __TaskPriorityLess> work_queue_;
         std::mutex                mutex_;
         std::condition_variable   cv_;
         std::atomic<bool>         dispatch_complete_;
+        // Bumped on every push anywhere. A worker only goes to sleep if it hasn't
+        // moved since right before its last (fruitless) scan — see workerLoop().
+        std::atomic<u64>          work_epoch_;
+        std::atomic<i32>          sleepers_;
+        // Tasks of the current dispatch not yet complete()d. The main thread sleeps on
+        // drained_cv_ until this hits 0, instead of polling anything.
+        std::atomic<usize>        remaining_;
+        std::condition_variable   drained_cv_;
+        // Pushed but not yet picked up by any worker, across every deque and the
+        // injection queue — only read for --trace's queue depth counter.
+        std::atomic<i64>          queued_ = 0;
+        // Admission control: the summed memory estimates of executing tasks stay at
+        // or under memory_budget_ bytes (0 = unlimited). Its own mutex — the wait can
+        // be long, and the injection queue's lock is on every worker's hot path.
+        u64                       memory_budget_ = 0;
+        u64                       memory_in_use_ = 0;
+        // Ticket lock over admission: waiters are admitted strictly in arrival order.
+        u64                       memory_next_ticket_    = 0;
+        u64                       memory_serving_ticket_ = 0;
+        std::mutex                memory_mutex_;
+        std::condition_variable   memory_cv_;
+
+        // Which pool/worker the calling thread is, if any — how pushReady() tells a
+        // worker's own push (local deque) from the main thread's (injection queue).
+        static inline thread_local ThreadPool* current_pool_   = nullptr;
+        static inline thread_local usize       current_worker_ = 0;
+
+        // Defined out-of-line, after Task, since the body needs Task::complete.
+        void workerLoop(usize index);
+
+        Task* findWork(usize index, u64& rng) {
+            if (Task* task = deques_[index]->pop()) {
+                return task;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (!work_queue_.empty()) {
+                    Task* task = work_queue_.top();
+                    work_queue_.pop();
+                    return task;
+                }
+            }
+
+            // xorshift — just enough to keep every idle worker from hammering the same
+            // victim first.
+            rng ^= rng << 13;
+            rng ^= rng >> 7;
+            rng ^= rng << 17;
+
+            usize count = deques_.size();
+            for (usize i = 0; i < count; ++i) {
+                usize victim = (rng + i) % count;
+                if (victim == index) {
+                    continue;
+                }
+                if (Task* task = deques_[victim]->steal()) {
+                    return task;
+                }
+            }
 
-        // Defined out-of-line, after Build, since the body needs Build::recordCompileCommand.
-        void workerLoop();
+            return nullptr;
+        }
+
+        // Pairs with the sleeper's sleepers_ increment in workerLoop(): either this
+        // sees it and notifies, or the sleeper sees the new epoch and never sleeps.
+        void notifyWork(usize count) {
+            work_epoch_.fetch_add(1);
+            if (sleepers_.load() > 0) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                for (usize i = 0; i < count; ++i) {
+                    cv_.notify_one();
+                }
+            }
+        }
 
     public:
-        ThreadPool() : dispatch_complete_(false) {}
+        ThreadPool() : dispatch_complete_(false), work_epoch_(0), sleepers_(0), remaining_(0) {}
 
         ~ThreadPool() { waitAll(); }
 
-        void setBuild(Build& build) { build_ = &build; }
+        // What a worker does with each task before complete()ing it — Build::runTask
+        // in a real build. The dispatch microbenchmark leaves it a no-op.
+        void setRunner(std::function<void(Task*)> runner) { runner_ = std::move(runner); }
+
+        void setMemoryBudget(u64 bytes) { memory_budget_ = bytes; }
+
+        u64 memoryBudget() const { return memory_budget_; }
+
+        // Blocks the calling worker until estimate fits in what's left of the budget.
+        // Always admits when nothing else is charged, so a task estimated above the
+        // whole budget still runs (alone) instead of never. Admission is first come,
+        // first served: a big task at the head of the line holds back smaller ones
+        // that would fit, or a steady stream of them could keep it waiting — with its
+        // worker's -j slot — for the rest of the build. Returns what was actually
+        // charged, to hand back to releaseMemory().
+        u64 acquireMemory(u64 estimate) {
+            if (memory_budget_ == 0 || estimate == 0) {
+                return 0;
+            }
+
+            std::unique_lock<std::mutex> lock(memory_mutex_);
+            u64 ticket = memory_next_ticket_++;
+            memory_cv_.wait(lock, [&] {
+                return ticket == memory_serving_ticket_ && (memory_in_use_ == 0 || memory_in_use_ + estimate <= memory_budget_);
+            });
+            memory_in_use_ += estimate;
+            ++memory_serving_ticket_;
+            lock.unlock();
+            // The next ticket may fit in what's left right away.
+            memory_cv_.notify_all();
+            return estimate;
+        }
+
+        void releaseMemory(u64 charged) {
+            if (charged == 0) {
+                return;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(memory_mutex_);
+                memory_in_use_ -= charged;
+            }
+            memory_cv_.notify_all();
+        }
 
         // Threads aren't spawned at construction — ThreadPool is a Build member, built
         // before Build's own constructor body runs, before -j has even been parsed.
         // Called explicitly from Build::build(), once the thread count is known and
         // there's actually a DAG ready to dispatch.
         void start(i32 thread_count = DEFAULT_THREAD_COUNT) {
+            threads_.clear();
+            deques_.clear();
+            dispatch_complete_.store(false);
             for (i32 i = 0; i < thread_count; ++i) {
-                threads_.emplace_back(&ThreadPool::workerLoop, this);
+                deques_.push_back(std::make_unique<__WorkStealingDeque<Task*>>());
+            }
+            for (i32 i = 0; i < thread_count; ++i) {
+                threads_.emplace_back(&ThreadPool::workerLoop, this, static_cast<usize>(i));
             }
         }
 
+        // Call before pushing any of the dispatch's roots — a root finishing fast
+        // enough to drain the count before it was even set would wake the main thread
+        // early.
+        void beginDispatch(usize task_count) { remaining_.store(task_count); }
+
+        i64 queued() const { return queued_.load(std::memory_order_relaxed); }
+
         void pushWork(Task* task) {
             {
                 std::lock_guard<std::mutex> lock(mutex_);
                 work_queue_.push(task);
+                work_epoch_.fetch_add(1);
             }
+            queued_.fetch_add(1, std::memory_order_relaxed);
             cv_.notify_one();
         }
 
+        // A whole dispatch's roots under one lock and one wakeup, rather than handing
+        // workers the injection-queue mutex back and forth once per root.
+        void pushWork(const std::vector<Task*>& tasks) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                for (Task* task : tasks) {
+                    work_queue_.push(task);
+                }
+                work_epoch_.fetch_add(1);
+            }
+            queued_.fetch_add(static_cast<i64>(tasks.size()), std::memory_order_relaxed);
+            cv_.notify_all();
+        }
+
+        // The tasks one complete() just unblocked. From a worker, only the most
+        // critical goes on its own deque, to run next while the inputs it just wrote
+        // are still warm. The rest go to the injection queue rather than the deque: a
+        // thief takes a deque's oldest entry, not its most critical, while idle workers
+        // check the injection queue before stealing and always get its highest-priority
+        // task.
+        void pushReady(std::vector<Task*>& ready) {
+            if (current_pool_ != this) {
+                pushWork(ready);
+                return;
+            }
+
+            std::iter_swap(std::max_element(ready.begin(), ready.end(), __TaskPriorityLess{}), ready.end() - 1);
+            queued_.fetch_add(static_cast<i64>(ready.size()), std::memory_order_relaxed);
+            deques_[current_worker_]->push(ready.back());
+            ready.pop_back();
+
+            if (!ready.empty()) {
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    for (Task* task : ready) {
+                        work_queue_.push(task);
+                    }
+                }
+                notifyWork(ready.size());
+            }
+        }
+
+        // Blocks until every task counted by beginDispatch() has completed. Tasks
+        // become ready through Task::complete(), so this is the only waiting the main
+        // thread does for the whole dispatch.
+        void waitDrained() {
+            std::unique_lock<std::mutex> lock(mutex_);
+            drained_cv_.wait(lock, [this] { return remaining_.load() == 0; });
+        }
+
         void signalDispatchComplete() {
             {
                 std::lock_guard<std::mutex> lock(mutex_);
@@ -1498,14 +4406,32 @@ class Build {
         // moment a later addGroup() call triggered a reallocation; list never
         // reallocates, so those addresses stay stable for the Build's whole lifetime.
         std::list<BuildGroup>                                           groups_;
+        // Every group's tasks, in registration order — deque, so the Task& handed back
+        // by addTask() stays valid as more are added, without a heap allocation per task.
+        std::deque<Task>                                                task_pool_;
+        TaskGraph                                                       graph_;
         ThreadPool                                                      thread_pool_;
-        std::unordered_map<std::filesystem::path, CompileCommandEntry> compile_commands_;
+        // Keyed by the interned source path — one entry per source, however many runs.
+        __PathMap<CompileCommandEntry>                                  compile_commands_;
         std::mutex                                                      compile_commands_mutex_;
-        std::atomic<bool>                                               failed_ = false;
+        // Set once -k's failure limit is hit, or on cancellation: workers stop starting
+        // tasks and skip through the rest, so the dispatch still drains normally.
+        std::atomic<bool>                                               stopping_ = false;
+        std::vector<std::string>                                        failures_;
+        std::mutex                                                      failures_mutex_;
+        std::atomic<usize>                                              skipped_count_ = 0;
         // Not atomic: only ever touched from addTask() during single-threaded build
         // setup, before the thread pool has any work to race over.
         usize                                                            command_counter_ = 0;
         i32                                                              jobs_;
+        // -k: how many failures to keep going through before stopping. 0 = never stop.
+        i32                                                              keep_going_;
+        // Self-pipe from the SIGINT/SIGTERM handler to signal_watcher_ (see
+        // watchSignals()) — write() is about all a handler can safely do.
+        static inline i32                                                signal_pipe_[2] = {-1, -1};
+        std::thread                                                     signal_watcher_;
+        struct sigaction                                                previous_sigint_  = {};
+        struct sigaction                                                previous_sigterm_ = {};
         // Kept around so parseArgs() (called separately, after any defineArg() calls
         // in the build script) can scan them — not consumed at construction time.
         int                                                              argc_;
@@ -1515,16 +4441,84 @@ class Build {
         // value into, without needing T at the point it's actually scanning argv.
         std::unordered_map<std::string, __ArgVariant>                  arg_defs_;
         std::unordered_map<std::string, __ArgVariant>                  arg_values_;
+        // Set by enablePgo(). The phase flags are swapped in and out by
+        // buildWithProfile() as it moves between the instrumented and optimized builds.
+        std::optional<Command>                                          pgo_training_;
+        std::string                                                     profdata_tool_ = "llvm-profdata";
+        std::vector<std::string>                                        phase_compile_flags_;
+        std::vector<std::string>                                        phase_link_flags_;
+        bool                                                            force_rebuild_ = false;
+        std::atomic<usize>                                              rebuilt_count_ = 0;
+        BuildHistory                                                    history_;
+        // Nanoseconds since the epoch at construction — tags every history record
+        // from this run, and orders runs in the log.
+        u64                                                             run_id_;
+        bool                                                            stats_ = false;
+        RemoteExecutor                                                  remote_;
+        // --shard i/n: 1-based index and shard count. --shard-merge: the final link
+        // step, using objects collected from every shard.
+        std::optional<std::pair<u32, u32>>                              shard_;
+        bool                                                            shard_merge_ = false;
+        // --trace out.json. Enabled before selfRebuild() runs, so it's the first
+        // thing on the main thread's track.
+        __TraceRecorder                                                 trace_;
+        std::filesystem::path                                           trace_path_;
+        std::atomic<i64>                                                running_ = 0;
+        // --time-trace: compile every Object with -ftime-trace and report on the
+        // traces once the build is done.
+        bool                                                            time_trace_ = false;
+        // --impact: which Objects each header reaches, filled in by buildDAG() from
+        // the dependency scan it already does. Keyed by the header's interned path.
+        bool                                                            impact_ = false;
+        __PathMap<std::vector<const Task*>>                             header_users_;
+        // --metrics out.prom.
+        __BuildMetrics                                                  metrics_;
+        std::filesystem::path                                           metrics_path_;
+        __BuildProgress                                                 progress_;
+        __CommandSignatures                                             signatures_;
+        // --explain.
+        __RebuildExplainer                                              explainer_;
 
     public:
         Build(const std::filesystem::path& build_dir, const std::string& compiler, int argc, char** argv)
             : build_dir_(build_dir), default_compiler_(compiler), argc_(argc), argv_(argv) {
-            selfRebuild(argc, argv);
+            trace_path_   = parsePathFlag(argc, argv, "--trace");
+            metrics_path_ = parsePathFlag(argc, argv, "--metrics");
+            if (!trace_path_.empty()) {
+                trace_.enable();
+            }
+            if (!metrics_path_.empty()) {
+                metrics_.enable();
+            }
+            progress_.enable();
+
+            timePhase("selfRebuild", [&] { selfRebuild(argc, argv); });
+
+            jobs_       = parseJobs(argc, argv);
+            keep_going_ = parseKeepGoing(argc, argv);
+            for (const std::string& worker : parseRemoteWorkers(argc, argv)) {
+                remote_.addWorker(worker);
+            }
 
-            jobs_ = parseJobs(argc, argv);
+            run_id_ = static_cast<u64>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+            for (int i = 1; i < argc; ++i) {
+                if (std::string(argv[i]) == "--stats") {
+                    stats_ = true;
+                } else if (std::string(argv[i]) == "--shard-merge") {
+                    shard_merge_ = true;
+                } else if (std::string(argv[i]) == "--time-trace") {
+                    time_trace_ = true;
+                } else if (std::string(argv[i]) == "--impact") {
+                    impact_ = true;
+                } else if (std::string(argv[i]) == "--explain") {
+                    explainer_.enable();
+                }
+            }
+            shard_ = parseShard(argc, argv);
 
             std::filesystem::create_directories(build_dir_);
-            thread_pool_.setBuild(*this);
+            thread_pool_.setRunner([this](Task* task) { runTask(task); });
+            thread_pool_.setMemoryBudget(parseMemoryLimit(argc, argv));
         }
 
         // -j is a build-tool built-in (controls ThreadPool sizing), parsed eagerly and
@@ -1546,7 +4540,11 @@ class Build {
                 }
 
                 std::string name = token.substr(2);
-                auto        def  = arg_defs_.find(name);
+                if (isBuiltinFlag(name)) {
+                    continue;
+                }
+
+                auto def = arg_defs_.find(name);
                 if (def == arg_defs_.end()) {
                     RLOG(LL_ERROR, "Unknown argument: --" + name);
                     continue;
@@ -1600,127 +4598,833 @@ class Build {
                 return std::nullopt;
             }
 
-            if (const T* value = std::get_if<T>(&it->second)) {
-                return *value;
+            if (const T* value = std::get_if<T>(&it->second)) {
+                return *value;
+            }
+            return std::nullopt;
+        }
+
+        // Unnamed groups are numbered in registration order: "group0", "group1", ...
+        BuildGroup& addGroup(const std::string& name = "") {
+            groups_.emplace_back();
+            BuildGroup& group = groups_.back();
+            group.setName(name.empty() ? "group" + std::to_string(groups_.size() - 1) : name);
+            group.setDefaultCompiler(default_compiler_);
+            group.setBuild(*this);
+            return group;
+        }
+
+        Task& newTask(Output output) { return task_pool_.emplace_back(std::move(output)); }
+
+        const std::filesystem::path& buildDir() const { return build_dir_; }
+
+        Os os() const { return os_; }
+
+        // Workers never exit() on a failure: they record it here and carry on with
+        // everything not downstream of it, until -k's limit says stop. build() reports
+        // the lot from the main thread once the dispatch has drained and state is saved.
+        bool hasFailed() {
+            std::lock_guard<std::mutex> lock(failures_mutex_);
+            return !failures_.empty();
+        }
+
+        bool stopping() const { return stopping_.load(); }
+
+        void reportFailure(const Task& task, i32 exit_code) {
+            std::lock_guard<std::mutex> lock(failures_mutex_);
+            failures_.push_back(task.sourcePath().string() + " (exit " + std::to_string(exit_code) + ")");
+            if (keep_going_ > 0 && failures_.size() >= static_cast<usize>(keep_going_)) {
+                stopping_.store(true);
+            }
+        }
+
+        // Three-phase profile-guided build, run by build() in place of a plain one: an
+        // instrumented build (-fprofile-generate) into pgoInstrumentedDir(), then
+        // training, then llvm-profdata merge and the real build with -fprofile-use.
+        // training is expected to exercise binaries under pgoInstrumentedDir() — the
+        // .profraw files land in pgoRawDir() regardless of its working directory.
+        void enablePgo(Command training) { pgo_training_ = std::move(training); }
+
+        void setProfdataTool(const std::string& tool) { profdata_tool_ = tool; }
+
+        std::filesystem::path pgoInstrumentedDir() const { return build_dir_ / "pgo" / "instrumented"; }
+
+        std::filesystem::path pgoRawDir() const { return std::filesystem::absolute(build_dir_ / "pgo" / "raw"); }
+
+        std::filesystem::path pgoProfile() const { return std::filesystem::absolute(build_dir_ / "pgo" / "default.profdata"); }
+
+        const std::vector<std::string>& phaseCompileFlags() const { return phase_compile_flags_; }
+
+        const std::vector<std::string>& phaseLinkFlags() const { return phase_link_flags_; }
+
+        // Set for the optimized phase when the merged profile's hash changed — every
+        // task's output depends on the profile, not just the ones whose sources moved.
+        bool forceRebuild() const { return force_rebuild_; }
+
+        bool timeTrace() const { return time_trace_; }
+
+        __CommandSignatures& commandSignatures() { return signatures_; }
+
+        __RebuildExplainer& explainer() { return explainer_; }
+
+        // Counts Object/Binary/Library executions only: Commands always rerun, so they
+        // say nothing about whether the instrumented binaries actually changed.
+        void recordRebuilt() { ++rebuilt_count_; }
+
+        void recordHistory(const Task& task, TaskOutcome outcome, const CommandOutput& result) {
+            history_.record(HistoryRecord{
+                run_id_, result.wall_seconds, result.cpu_seconds, result.peak_rss_bytes, result.exit_code, outcome, task.kind(),
+                task.outputPath().string(),
+            });
+        }
+
+        // What each worker does with a task it picked up, between being handed it and
+        // complete()ing it: executeTask(), plus its --trace slice. Both defined
+        // out-of-line, after Task::needsRebuild.
+        void runTask(Task* task);
+
+        // nullopt for a task this shard doesn't run at all.
+        std::optional<TaskOutcome> executeTask(Task* task);
+
+        // 1-indexed: after N commands have been added, the Nth one is "cmd_N".
+        usize nextCommandId() { return ++command_counter_; }
+
+        // Built-in --flags aren't defineArg()'d, but parseArgs() still has to step over
+        // them instead of reporting them as unknown.
+        static bool isBuiltinFlag(const std::string& name) {
+            static const std::unordered_set<std::string> builtins = {"stats", "mem-limit", "remote", "shard", "shard-merge", "trace", "time-trace", "impact", "metrics", "explain"};
+            return builtins.contains(name);
+        }
+
+        // Recorded unconditionally by every worker before checking needsRebuild(), so
+        // compile_commands.json stays complete even when most tasks are skipped on an
+        // incremental build.
+        void recordCompileCommand(const Task& task, CompileCommandEntry entry) {
+            std::lock_guard<std::mutex> lock(compile_commands_mutex_);
+            compile_commands_[task.sourceId()] = std::move(entry);
+        }
+
+        void exportCompileCommands(const std::filesystem::path& path = "compile_commands.json") const {
+            std::ofstream file(path);
+            if (!file) {
+                RLOG(LL_ERROR, "Failed to open " + path.string());
+                return;
+            }
+
+            file << "[\n";
+
+            usize i     = 0;
+            usize total = compile_commands_.size();
+            compile_commands_.forEach([&](u32, const CompileCommandEntry& entry) {
+                file << "\t{\n";
+                file << "\t\t\"directory\": \"" << entry.directory.string() << "\",\n";
+                file << "\t\t\"command\": \"" << entry.command << "\",\n";
+                file << "\t\t\"file\": \"" << entry.file.string() << "\"\n";
+                file << "\t}";
+                file << (++i < total ? ",\n" : "\n");
+            });
+
+            file << "]";
+        }
+
+        void print() {
+            RLOG(LL_DEBUG, "Build: " + std::to_string(task_pool_.size()) + " tasks");
+
+            for (const Task& task : task_pool_) {
+                task.print();
+            }
+        }
+
+        i32 jobs() const { return jobs_; }
+
+        // "unix:/path" or "host:port" of a running worker.cpp daemon — same as passing
+        // --remote on the command line. -j is then how many compiles are in flight
+        // across every worker (and the local fallback), so raise it past local cores.
+        void addRemoteWorker(const std::string& endpoint) { remote_.addWorker(endpoint); }
+
+        // Objects only, and only outside a PGO phase: its -fprofile-use/-generate paths
+        // point into this machine's build dir, which a worker doesn't have. Likewise
+        // under --time-trace, whose JSON a worker would write into its scratch dir.
+        RemoteExecutor* remote() { return remote_.enabled() && phase_compile_flags_.empty() && !time_trace_ ? &remote_ : nullptr; }
+
+        void build() {
+            i64                   started      = __TraceRecorder::now();
+            std::filesystem::path history_path    = build_dir_ / "history.bin";
+            std::filesystem::path signatures_path = build_dir_ / "commands.sig";
+            history_.load(history_path);
+            signatures_.load(signatures_path);
+
+            if (stats_) {
+                history_.report();
+                return;
+            }
+
+            if (impact_) {
+                buildDAG();
+                reportImpact();
+                return;
+            }
+
+            timePhase("buildDAG", [&] { buildDAG(); });
+            markLtoObjects();
+	    print();
+
+            if (shard_.has_value() || shard_merge_) {
+                if (pgo_training_.has_value()) {
+                    RLOG(LL_FATAL, "PGO builds can't be sharded — training needs the whole instrumented build on one machine");
+                }
+                if (shard_.has_value()) {
+                    selectShard(shard_->first, shard_->second);
+                } else {
+                    excludeShardedObjects();
+                }
+            }
+
+            watchSignals();
+            if (pgo_training_.has_value()) {
+                buildWithProfile();
+            } else {
+                runDAG();
+            }
+            unwatchSignals();
+
+            // Saved whether or not the build went through — whatever did complete is
+            // up to date on disk, and its history and compile commands are still valid.
+            exportCompileCommands();
+            history_.save(history_path);
+            signatures_.save(signatures_path);
+            if (trace_.enabled()) {
+                trace_.write(trace_path_);
+            }
+            if (time_trace_) {
+                reportTimeTrace();
+            }
+            if (metrics_.enabled()) {
+                metrics_.recordPhase("total", (__TraceRecorder::now() - started) / 1e9);
+                metrics_.write(metrics_path_, failures_.size());
+            }
+            reportFailures();
+        }
+
+    private:
+        // Every Object's trace, not just this run's recompiles — an up-to-date object's
+        // trace from its last compile still describes it.
+        void reportTimeTrace() const {
+            __TimeTraceReport report;
+            for (const Task& task : task_pool_) {
+                if (task.isObject() && !task.excluded()) {
+                    report.add(__TimeTraceReport::tracePathFor(task.outputPath()));
+                }
+            }
+            report.report();
+        }
+
+        // Commits touching each file over the last days days, keyed by canonical path.
+        // Empty outside a git checkout.
+        static std::unordered_map<std::string, usize> gitChurn(u32 days) {
+            std::unordered_map<std::string, usize> churn;
+
+            CommandOutput toplevel = Command({"git", "rev-parse", "--show-toplevel"}).exec();
+            if (toplevel.exit_code != 0) {
+                return churn;
+            }
+            std::filesystem::path root = toplevel.stdout_output.substr(0, toplevel.stdout_output.find('\n'));
+
+            CommandOutput log = Command({"git", "log", "--since=" + std::to_string(days) + ".days", "--format=", "--name-only"}).exec();
+            std::unordered_map<std::string, usize> by_name;
+            std::istringstream                     lines(log.stdout_output);
+            std::string                            line;
+            while (std::getline(lines, line)) {
+                if (!line.empty()) {
+                    ++by_name[line];
+                }
+            }
+
+            for (const auto& [name, commits] : by_name) {
+                std::error_code error;
+                churn[std::filesystem::weakly_canonical(root / name, error).string()] += commits;
+            }
+            return churn;
+        }
+
+        // Backs ./build --impact: what touching each header costs in rebuild time —
+        // every TU that transitively includes it, priced at its last recorded compile
+        // time — and which of the expensive ones actually get touched often.
+        void reportImpact(usize top = 15) {
+            static constexpr u32 CHURN_DAYS = 90;
+
+            struct Impact {
+                    u32   header;
+                    usize users;
+                    f64   seconds;
+                    usize commits;
+            };
+
+            std::unordered_map<std::string, usize> churn    = gitChurn(CHURN_DAYS);
+            PathInterner&                          interner = PathInterner::instance();
+            std::vector<Impact>                    impacts;
+            usize                                  objects  = 0;
+            usize                                  untimed  = 0;
+
+            for (Task& task : task_pool_) {
+                task.resolveOutputPath(build_dir_);
+                if (task.isObject()) {
+                    ++objects;
+                    untimed += !history_.lastDuration(task.outputPath().string()).has_value();
+                }
+            }
+
+            header_users_.forEach([&](u32 header, const std::vector<const Task*>& users) {
+                f64 seconds = 0.0;
+                for (const Task* task : users) {
+                    seconds += history_.lastDuration(task->outputPath().string()).value_or(0.0);
+                }
+
+                std::error_code error;
+                auto            commits = churn.find(std::filesystem::weakly_canonical(std::filesystem::path(interner.text(header)), error).string());
+                impacts.push_back(Impact{header, users.size(), seconds, commits != churn.end() ? commits->second : 0});
+            });
+
+            if (impacts.empty()) {
+                RLOG(LL_INFO, "No header dependencies found");
+                return;
+            }
+            if (untimed > 0) {
+                RLOG(LL_WARN, "%zu of %zu objects have no compile time on record yet — their share of each cost below is missing", untimed, objects);
+            }
+
+            auto print = [&](const char* title, usize count) {
+                RLOG(LL_INFO, "%s (rebuild seconds, TUs, commits in %u days):", title, CHURN_DAYS);
+                for (usize i = 0; i < std::min(top, count); ++i) {
+                    const Impact& impact = impacts[i];
+                    RLOG(LL_INFO, "  %9.2f %6zu %5zu  %s", impact.seconds, impact.users, impact.commits, std::string(interner.text(impact.header)).c_str());
+                }
+            };
+
+            std::sort(impacts.begin(), impacts.end(), [](const Impact& a, const Impact& b) {
+                return a.seconds != b.seconds ? a.seconds > b.seconds : a.users > b.users;
+            });
+            print("Most expensive headers to touch", impacts.size());
+
+            // Cost times churn is roughly the rebuild time a header has actually cost
+            // over the window: those are the ones worth splitting or forward-declaring.
+            auto churned = std::partition(impacts.begin(), impacts.end(), [](const Impact& impact) { return impact.commits > 0; });
+            std::sort(impacts.begin(), churned, [](const Impact& a, const Impact& b) {
+                return a.seconds * a.commits > b.seconds * b.commits;
+            });
+            if (churned != impacts.begin()) {
+                print("Hot spots: high fan-in and frequently changed", static_cast<usize>(churned - impacts.begin()));
+            }
+        }
+
+        // One full dispatch of the DAG. Re-runnable: the graph is reset() first, and
+        // the pool respawns its threads on each start().
+        void runDAG() {
+            freezeGroups();
+            graph_.reset();
+            for (Task& task : task_pool_) {
+                task.resolveOutputPath(build_dir_);
+            }
+
+            std::vector<Task*> roots;
+            for (u32 id : graph_.roots()) {
+                roots.push_back(graph_.task(id));
+            }
+
+            rebuilt_count_.store(0);
+            std::vector<f64> estimates = computePriorities();
+            estimateMemory();
+
+            explainer_.begin(graph_.size());
+            timePhase("dispatch " + build_dir_.string(), [&] {
+                if (observed()) {
+                    graph_.trackReadyTimes();
+                    i64 now = __TraceRecorder::now();
+                    for (u32 id : graph_.roots()) {
+                        graph_.setReadyTime(id, now);
+                    }
+                }
+
+                progress_.begin(graph_, std::move(estimates), jobs_);
+                thread_pool_.start(jobs_);
+                thread_pool_.beginDispatch(graph_.size());
+
+                // Only the roots are pushed from here — everything else is pushed by its
+                // last parent's complete() on whichever worker ran it.
+                thread_pool_.pushWork(roots);
+
+                thread_pool_.waitDrained();
+                thread_pool_.waitAll();
+                progress_.end();
+            });
+            explainer_.report(graph_);
+        }
+
+        // Whether runTask() has to time tasks at all.
+        bool observed() const { return trace_.enabled() || metrics_.enabled(); }
+
+        // A slice on --trace's main track and a phase duration for --metrics.
+        template <typename F>
+        void timePhase(const std::string& phase, F&& body) {
+            __TraceScope scope(trace_, phase, "phase");
+            i64          start = __TraceRecorder::now();
+            body();
+            if (metrics_.enabled()) {
+                metrics_.recordPhase(phase, (__TraceRecorder::now() - start) / 1e9);
+            }
+        }
+
+        void buildWithProfile() {
+            std::filesystem::path build_dir = build_dir_;
+            std::filesystem::path raw_dir   = pgoRawDir();
+            std::filesystem::path profile   = pgoProfile();
+
+            RLOG(LL_INFO, "PGO: instrumented build into " + pgoInstrumentedDir().string());
+            build_dir_           = pgoInstrumentedDir();
+            phase_compile_flags_ = {"-fprofile-generate=" + raw_dir.string()};
+            phase_link_flags_    = phase_compile_flags_;
+            std::filesystem::create_directories(build_dir_);
+            runDAG();
+            build_dir_ = build_dir;
+            phase_compile_flags_.clear();
+            phase_link_flags_.clear();
+
+            // Training a partial instrumented build would only produce a partial profile.
+            if (hasFailed() || stopping()) {
+                return;
+            }
+
+            // Unchanged instrumented binaries would just reproduce the same profile —
+            // only retrain when one of them was actually rebuilt, or there's no profile.
+            if (rebuilt_count_.load() > 0 || !std::filesystem::exists(profile)) {
+                std::filesystem::remove_all(raw_dir);
+                std::filesystem::create_directories(raw_dir);
+
+                RLOG(LL_INFO, "PGO: training: " + pgo_training_->string());
+                if (pgo_training_->run() != 0) {
+                    RLOG(LL_FATAL, "PGO training command failed");
+                }
+
+                Command merge({profdata_tool_, "merge", "-output=" + profile.string()});
+                for (const auto& entry : std::filesystem::directory_iterator(raw_dir)) {
+                    if (entry.path().extension() == ".profraw") {
+                        merge.push_back(entry.path().string());
+                    }
+                }
+
+                CommandOutput merged = merge.exec();
+                if (merged.exit_code != 0) {
+                    RLOG(LL_FATAL, "PGO profile merge failed: " + merged.stderr_output);
+                }
+            }
+
+            // Hash, not mtime: a retrain that happens to produce an identical profile
+            // shouldn't cost a full optimized rebuild.
+            std::filesystem::path hash_path = build_dir_ / "pgo" / "profile.hash";
+            std::string           hash      = hashFile(profile);
+            std::string           previous;
+            std::ifstream(hash_path) >> previous;
+
+            force_rebuild_ = hash != previous;
+            if (force_rebuild_) {
+                RLOG(LL_INFO, "PGO: profile changed, rebuilding everything");
+            }
+
+            RLOG(LL_INFO, "PGO: optimized build");
+            phase_compile_flags_ = {"-fprofile-use=" + profile.string()};
+            phase_link_flags_    = phase_compile_flags_;
+            runDAG();
+            force_rebuild_ = false;
+            phase_compile_flags_.clear();
+            phase_link_flags_.clear();
+
+            // Only after the optimized build went through: a failed one has to be
+            // retried against the new profile next time, not skipped as up to date.
+            if (!hasFailed() && !stopping()) {
+                std::ofstream(hash_path) << hash;
+            }
+        }
+
+        static std::string hashFile(const std::filesystem::path& path) {
+            std::ifstream file(path, std::ios::binary);
+            u64           hash = __fnv1a("");
+            char          buffer[4096];
+
+            while (file.read(buffer, sizeof(buffer)) || file.gcount() > 0) {
+                hash = __fnv1a(std::string_view(buffer, static_cast<usize>(file.gcount())), hash);
+            }
+
+            char hex[17];
+            snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(hash));
+            return hex;
+        }
+
+        // Dedicated, hardcoded parse — separate from the generic defineArg()/parseArgs()
+        // system, since -j is a build-tool built-in, not something a script opts into.
+        // First occurrence wins; a missing/unparseable value falls back to the default
+        // and logs an error rather than blocking the rest of the build.
+        i32 parseJobs(int argc, char** argv) const {
+            for (int i = 1; i < argc - 1; ++i) {
+                if (std::string(argv[i]) == "-j") {
+                    try {
+                        return static_cast<i32>(std::stoi(argv[i + 1]));
+                    } catch (...) {
+                        RLOG(LL_ERROR, "Invalid value for -j: " + std::string(argv[i + 1]));
+                        return ThreadPool::DEFAULT_THREAD_COUNT;
+                    }
+                }
+            }
+            return ThreadPool::DEFAULT_THREAD_COUNT;
+        }
+
+        // --mem-limit takes bytes, with an optional K/M/G suffix (powers of 1024). With
+        // no flag, falls back to the container's cgroup limit — that's the number the
+        // OOM killer actually enforces, not the host's physical RAM. 0 = unlimited.
+        u64 parseMemoryLimit(int argc, char** argv) const {
+            for (int i = 1; i < argc - 1; ++i) {
+                if (std::string(argv[i]) != "--mem-limit") {
+                    continue;
+                }
+
+                std::string raw = argv[i + 1];
+                try {
+                    usize consumed = 0;
+                    f64   value    = std::stod(raw, &consumed);
+                    u64   scale    = 1;
+                    switch (consumed < raw.size() ? std::toupper(static_cast<unsigned char>(raw[consumed])) : 0) {
+                        case 'G':
+                            scale <<= 10;
+                            [[fallthrough]];
+                        case 'M':
+                            scale <<= 10;
+                            [[fallthrough]];
+                        case 'K':
+                            scale <<= 10;
+                            [[fallthrough]];
+                        case 0:
+                            return static_cast<u64>(value * static_cast<f64>(scale));
+                        default:
+                            break;
+                    }
+                } catch (...) {
+                }
+                RLOG(LL_ERROR, "Invalid value for --mem-limit: " + raw);
+                return 0;
             }
-            return std::nullopt;
-        }
 
-        BuildGroup& addGroup() {
-            groups_.emplace_back();
-            BuildGroup& group = groups_.back();
-            group.setDefaultCompiler(default_compiler_);
-            group.setBuild(*this);
-            return group;
+            u64 limit = cgroupMemoryLimit();
+            if (limit > 0) {
+                RLOG(LL_DEBUG, "Memory budget from cgroup: " + std::to_string(limit / (1024 * 1024)) + " MiB");
+            }
+            return limit;
         }
 
-        const std::filesystem::path& buildDir() const { return build_dir_; }
+        // cgroup v2's memory.max, else v1's memory.limit_in_bytes, minus a tenth for
+        // headroom: the cgroup also charges this process, the shell, the linker's
+        // page cache — none of which any task estimate accounts for. 0 when there is
+        // no limit (v2's "max", v1's near-2^63 sentinel) or no cgroup at all.
+        static u64 cgroupMemoryLimit() {
+            for (const char* path : {"/sys/fs/cgroup/memory.max", "/sys/fs/cgroup/memory/memory.limit_in_bytes"}) {
+                std::ifstream file(path);
+                std::string   raw;
+                if (!(file >> raw) || raw == "max") {
+                    continue;
+                }
 
-        Os os() const { return os_; }
+                try {
+                    u64 limit = std::stoull(raw);
+                    if (limit < (u64(1) << 60)) {
+                        return limit - limit / 10;
+                    }
+                } catch (...) {
+                }
+            }
+            return 0;
+        }
 
-        // Not what actually stops the other worker threads — RLOG(LL_FATAL, ...) does
-        // that for free by calling exit() the instant any thread hits a failure, which
-        // is process-wide. This just lets a thread skip starting new work in the narrow
-        // window before that exit() call lands, and keeps two near-simultaneous
-        // failures from racing to log a garbled fatal message.
-        bool hasFailed() const { return failed_.load(); }
+        // Each task's expected peak RSS, worked out on the main thread before the
+        // dispatch (BuildHistory isn't safe to read while workers are recording into
+        // it): worst on record, else its group's hint, else the mean across history.
+        void estimateMemory() {
+            if (thread_pool_.memoryBudget() == 0) {
+                return;
+            }
 
-        void reportFailure() { failed_.store(true); }
+            u64 fallback = history_.meanPeakRss();
+            for (u32 id = 0; id < graph_.size(); ++id) {
+                Task*              task     = graph_.task(id);
+                std::optional<u64> estimate = history_.peakRss(task->outputPath().string());
+                if (!estimate.has_value()) {
+                    estimate = task->memoryHint();
+                }
+                graph_.setMemoryEstimate(id, estimate.value_or(fallback));
+            }
+        }
 
-        // 1-indexed: after N commands have been added, the Nth one is "cmd_N".
-        usize nextCommandId() { return ++command_counter_; }
+        // --shard i/n, 1 <= i <= n.
+        static std::optional<std::pair<u32, u32>> parseShard(int argc, char** argv) {
+            for (int i = 1; i < argc - 1; ++i) {
+                if (std::string(argv[i]) != "--shard") {
+                    continue;
+                }
 
-        // Recorded unconditionally by every worker before checking needsRebuild(), so
-        // compile_commands.json stays complete even when most tasks are skipped on an
-        // incremental build.
-        void recordCompileCommand(CompileCommandEntry entry) {
-            std::lock_guard<std::mutex> lock(compile_commands_mutex_);
-            compile_commands_[entry.file] = std::move(entry);
+                u32 index = 0;
+                u32 count = 0;
+                if (sscanf(argv[i + 1], "%u/%u", &index, &count) != 2 || index < 1 || index > count) {
+                    RLOG(LL_FATAL, "Invalid value for --shard: " + std::string(argv[i + 1]) + " (expected i/n, 1 <= i <= n)");
+                }
+                return std::pair{index, count};
+            }
+            return std::nullopt;
         }
 
-        void exportCompileCommands(const std::filesystem::path& path = "compile_commands.json") const {
-            std::ofstream file(path);
-            if (!file) {
-                RLOG(LL_ERROR, "Failed to open " + path.string());
-                return;
+        // Splits the Objects into count shards by longest-processing-time-first: heaviest
+        // first, each onto the least-loaded shard so far. Weight is the last recorded
+        // compile time, or source size for Objects with no history — scaled into
+        // seconds by the history's overall seconds-per-byte when there is any. Every
+        // shard has to compute the same split on its own, so this only depends on the
+        // sources and on build history, which then has to be the same on every shard
+        // (e.g. restored from one CI cache) or not there at all. Ties fall back to
+        // source path order, never to hash-map order.
+        //
+        // This shard's Objects run together with the Commands they depend on (one
+        // generating a header, say). Object-to-Object edges from buildDAG() are
+        // ordering only, so other shards' Objects stay out; every Binary and Library —
+        // and anything only reachable through one — is left to the --shard-merge run.
+        // Its objects are listed in build_dir/shard-i-of-n.txt, for the CI job to
+        // collect as artifacts for that run.
+        void selectShard(u32 index, u32 count) {
+            std::vector<Task*> objects;
+            for (Task& task : task_pool_) {
+                if (task.isObject()) {
+                    objects.push_back(&task);
+                }
             }
 
-            file << "[\n";
+            f64 known_seconds = 0.0;
+            f64 known_bytes   = 0.0;
+            for (Task* task : objects) {
+                if (auto seconds = history_.lastDuration(task->outputPath(build_dir_).string())) {
+                    known_seconds += *seconds;
+                    known_bytes += static_cast<f64>(sourceSize(*task));
+                }
+            }
+            f64 seconds_per_byte = known_bytes > 0.0 ? known_seconds / known_bytes : 1.0;
 
-            usize i     = 0;
-            usize total = compile_commands_.size();
-            for (const auto& [key, entry] : compile_commands_) {
-                file << "\t{\n";
-                file << "\t\t\"directory\": \"" << entry.directory.string() << "\",\n";
-                file << "\t\t\"command\": \"" << entry.command << "\",\n";
-                file << "\t\t\"file\": \"" << entry.file.string() << "\"\n";
-                file << "\t}";
-                file << (++i < total ? ",\n" : "\n");
+            std::vector<std::pair<f64, Task*>> weighted;
+            for (Task* task : objects) {
+                std::optional<f64> seconds = history_.lastDuration(task->outputPath(build_dir_).string());
+                weighted.emplace_back(seconds.value_or(static_cast<f64>(sourceSize(*task)) * seconds_per_byte), task);
+            }
+            std::sort(weighted.begin(), weighted.end(), [](const auto& a, const auto& b) {
+                if (a.first != b.first) {
+                    return a.first > b.first;
+                }
+                return a.second->sourcePath() < b.second->sourcePath();
+            });
+
+            std::vector<f64> load(count, 0.0);
+            std::vector<u8>  selected(graph_.size(), 0);
+            usize            selected_count = 0;
+            for (const auto& [weight, task] : weighted) {
+                usize lightest = static_cast<usize>(std::min_element(load.begin(), load.end()) - load.begin());
+                load[lightest] += weight;
+                if (lightest == index - 1) {
+                    selected[task->id()] = 1;
+                    ++selected_count;
+                }
             }
 
-            file << "]";
-        }
+            std::vector<u8> keep = selected;
+            std::vector<u8> visited(graph_.size(), 0);
+            for (u32 id = 0; id < graph_.size(); ++id) {
+                if (!selected[id]) {
+                    continue;
+                }
+                graph_.forEachAncestor(id, visited, [&](u32 ancestor) -> bool {
+                    const Task* task = graph_.task(ancestor);
+                    if (task->isCommand()) {
+                        keep[ancestor] = 1;
+                    }
+                    return task->isCommand() || task->isObject();
+                });
+            }
 
-        void print() {
-            usize total = 0;
-            for (auto& group : groups_) {
-                total += group.tasks().size();
+            for (u32 id = 0; id < graph_.size(); ++id) {
+                if (!keep[id]) {
+                    graph_.task(id)->setExcluded();
+                }
             }
-            RLOG(LL_DEBUG, "Build: " + std::to_string(total) + " tasks");
 
-            for (auto& group : groups_) {
-                for (auto& [key, task] : group.tasks()) {
-                    task->print();
+            std::filesystem::path manifest = build_dir_ / ("shard-" + std::to_string(index) + "-of-" + std::to_string(count) + ".txt");
+            std::ofstream         file(manifest);
+            for (const auto& [weight, task] : weighted) {
+                if (selected[task->id()]) {
+                    file << task->outputPath(build_dir_).string() << "\n";
                 }
             }
+
+            RLOG(
+                LL_INFO, "Shard %u/%u: %zu of %zu objects (load %.2f%s, heaviest shard %.2f), listed in %s", index, count, selected_count, objects.size(),
+                load[index - 1], known_bytes > 0.0 ? "s" : " source bytes", *std::max_element(load.begin(), load.end()), manifest.string().c_str()
+            );
         }
 
-        void build() {
-            buildDAG();
-	    print();
+        // --shard-merge: every Object comes from the shards' artifacts, copied into
+        // build_dir at the same paths — none are compiled here. A missing one means an
+        // incomplete artifact collection, so that's fatal up front rather than a
+        // confusing link error later.
+        void excludeShardedObjects() {
+            std::vector<std::string> missing;
+            for (Task& task : task_pool_) {
+                if (!task.isObject()) {
+                    continue;
+                }
+
+                task.setExcluded();
+                if (!std::filesystem::exists(task.outputPath(build_dir_))) {
+                    missing.push_back(task.outputPath(build_dir_).string());
+                }
+            }
 
-            thread_pool_.start(jobs_);
+            if (!missing.empty()) {
+                std::sort(missing.begin(), missing.end());
+                for (const std::string& path : missing) {
+                    RLOG(LL_ERROR, "Missing shard artifact: " + path);
+                }
+                RLOG(LL_FATAL, "--shard-merge: " + std::to_string(missing.size()) + " object(s) missing — were every shard's artifacts collected?");
+            }
+        }
 
-            std::forward_list<Task*> pending = collectTasks();
+        static u64 sourceSize(const Task& task) {
+            std::error_code error;
+            u64             size = std::filesystem::file_size(task.sourcePath(), error);
+            return error ? 0 : size;
+        }
 
-            while (!pending.empty()) {
-                auto prev = pending.before_begin();
-                auto it   = pending.begin();
+        // --trace out.json, --metrics out.prom. Empty if not given.
+        static std::filesystem::path parsePathFlag(int argc, char** argv, const std::string& flag) {
+            for (int i = 1; i < argc - 1; ++i) {
+                if (std::string(argv[i]) == flag) {
+                    return argv[i + 1];
+                }
+            }
+            return {};
+        }
 
-                while (it != pending.end()) {
-                    Task* task = *it;
+        // --remote a,b,c — comma-separated, every occurrence counts.
+        static std::vector<std::string> parseRemoteWorkers(int argc, char** argv) {
+            std::vector<std::string> workers;
+            for (int i = 1; i < argc - 1; ++i) {
+                if (std::string(argv[i]) != "--remote") {
+                    continue;
+                }
 
-                    if (task->parentCount() == 0) {
-                        thread_pool_.pushWork(task);
-                        it = pending.erase_after(prev);
-                    } else {
-                        prev = it;
-                        ++it;
+                std::istringstream list(argv[i + 1]);
+                std::string        worker;
+                while (std::getline(list, worker, ',')) {
+                    if (!worker.empty()) {
+                        workers.push_back(worker);
                     }
                 }
             }
-
-            thread_pool_.waitAll();
-            exportCompileCommands();
+            return workers;
         }
 
-    private:
-        // Dedicated, hardcoded parse — separate from the generic defineArg()/parseArgs()
-        // system, since -j is a build-tool built-in, not something a script opts into.
-        // First occurrence wins; a missing/unparseable value falls back to the default
-        // and logs an error rather than blocking the rest of the build.
-        i32 parseJobs(int argc, char** argv) const {
+        // Same as parseJobs(), for -k. Defaults to 1: stop starting new tasks after the
+        // first failure. "-k 0" keeps going no matter how many fail.
+        i32 parseKeepGoing(int argc, char** argv) const {
             for (int i = 1; i < argc - 1; ++i) {
-                if (std::string(argv[i]) == "-j") {
+                if (std::string(argv[i]) == "-k") {
                     try {
-                        return static_cast<i32>(std::stoi(argv[i + 1]));
+                        return std::max(0, static_cast<i32>(std::stoi(argv[i + 1])));
                     } catch (...) {
-                        RLOG(LL_ERROR, "Invalid value for -j: " + std::string(argv[i + 1]));
-                        return ThreadPool::DEFAULT_THREAD_COUNT;
+                        RLOG(LL_ERROR, "Invalid value for -k: " + std::string(argv[i + 1]));
+                        return 1;
                     }
                 }
             }
-            return ThreadPool::DEFAULT_THREAD_COUNT;
+            return 1;
+        }
+
+        static void onSignal(int signal) {
+            u8 byte = static_cast<u8>(signal);
+            (void)!write(signal_pipe_[1], &byte, 1);
+        }
+
+        // SIGINT/SIGTERM mid-build, instead of killing the process with compilers still
+        // running and nothing saved: stop starting tasks, SIGTERM every in-flight
+        // child's process group, and let the dispatch drain so build() still persists
+        // whatever completed. The handler goes back to the default on the first signal,
+        // so a second one aborts outright.
+        void watchSignals() {
+            if (!__cloexecPipe(signal_pipe_)) {
+                RLOG(LL_ERROR, "Failed to create signal pipe — interrupting the build won't stop it cleanly");
+                return;
+            }
+            // Only the write end: the handler must never block on a full pipe, while
+            // the watcher is meant to block reading the other one.
+            fcntl(signal_pipe_[1], F_SETFL, fcntl(signal_pipe_[1], F_GETFL) | O_NONBLOCK);
+
+            struct sigaction action = {};
+            action.sa_handler       = onSignal;
+            sigemptyset(&action.sa_mask);
+            sigaction(SIGINT, &action, &previous_sigint_);
+            sigaction(SIGTERM, &action, &previous_sigterm_);
+
+            signal_watcher_ = std::thread([this] {
+                u8 byte = 0;
+                while (read(signal_pipe_[0], &byte, 1) < 0 && errno == EINTR) {
+                }
+                // 0 is unwatchSignals() asking the watcher to exit, not a signal.
+                if (byte == 0) {
+                    return;
+                }
+
+                signal(SIGINT, SIG_DFL);
+                signal(SIGTERM, SIG_DFL);
+                RLOG(LL_WARN, "Interrupted — terminating running tasks and saving build state (interrupt again to abort)");
+                stopping_.store(true);
+                __ChildProcesses::instance().cancel();
+            });
+        }
+
+        void unwatchSignals() {
+            if (!signal_watcher_.joinable()) {
+                return;
+            }
+
+            sigaction(SIGINT, &previous_sigint_, nullptr);
+            sigaction(SIGTERM, &previous_sigterm_, nullptr);
+
+            u8 byte = 0;
+            (void)!write(signal_pipe_[1], &byte, 1);
+            signal_watcher_.join();
+
+            close(signal_pipe_[0]);
+            close(signal_pipe_[1]);
+            signal_pipe_[0] = signal_pipe_[1] = -1;
+        }
+
+        // Every failure the run hit, all at once, then a non-zero exit — from the main
+        // thread, after the build state has been saved.
+        void reportFailures() {
+            bool cancelled = __ChildProcesses::instance().cancelled();
+            if (failures_.empty() && !cancelled) {
+                return;
+            }
+
+            for (const std::string& failure : failures_) {
+                RLOG(LL_ERROR, "Failed: " + failure);
+            }
+            if (skipped_count_.load() > 0) {
+                RLOG(LL_ERROR, std::to_string(skipped_count_.load()) + " task(s) not built due to earlier failures or cancellation");
+            }
+
+            if (cancelled) {
+                RLOG(LL_FATAL, "Build cancelled");
+            }
+            RLOG(LL_FATAL, "Build failed: " + std::to_string(failures_.size()) + " task(s) failed");
         }
 
         // Compares this build script's own source (found via __BASE_FILE__ — the
@@ -1768,33 +5472,167 @@ class Build {
             std::exit(0);
         }
 
-        std::forward_list<Task*> collectTasks() {
-            std::forward_list<Task*> all;
-            for (auto& group : groups_) {
-                for (auto& [key, task] : group.tasks()) {
-                    all.push_front(task.get());
+        // Longest remaining path to a sink, by each task's last recorded duration — one
+        // pass over the graph in reverse topological order, so every child is ranked
+        // before its parents. Keys include build_dir, so each PGO phase ranks by its
+        // own timings.
+        // Returns each task's own estimate, indexed by id, for the progress line's ETA.
+        std::vector<f64> computePriorities() {
+            f64                     fallback = history_.meanDuration();
+            const std::vector<u32>& order    = graph_.topologicalOrder();
+            std::vector<f64>        estimates(graph_.size());
+
+            for (auto it = order.rbegin(); it != order.rend(); ++it) {
+                f64 longest_child = 0.0;
+                for (u32 child : graph_.children(*it)) {
+                    longest_child = std::max(longest_child, graph_.priority(child));
+                }
+
+                estimates[*it] = history_.lastDuration(graph_.task(*it)->outputPath().string()).value_or(fallback);
+                graph_.setPriority(*it, estimates[*it] + longest_child);
+            }
+            return estimates;
+        }
+
+        // Bitcode has to come from the compile, not the link: every Object upstream of
+        // a ThinLTO Binary/Library gets -flto=thin, including through a static library
+        // sitting between them.
+        void markLtoObjects() {
+            std::vector<u8> visited(graph_.size(), 0);
+            for (u32 id = 0; id < graph_.size(); ++id) {
+                if (!graph_.task(id)->isLto()) {
+                    continue;
+                }
+
+                // Only a static archive's members end up in this link. A Binary or shared
+                // Library upstream is linked on its own — its objects are bitcode only if
+                // it's an LTO link itself, which its own walk takes care of.
+                graph_.forEachAncestor(id, visited, [&](u32 ancestor) -> bool {
+                    Task* task = graph_.task(ancestor);
+                    if (task->isObject()) {
+                        task->setLto();
+                    }
+                    return task->kind() != TaskKind::Binary && (task->kind() != TaskKind::Library || task->isStaticLibrary());
+                });
+            }
+        }
+
+        void freezeGroups() {
+            for (BuildGroup& group : groups_) {
+                group.freeze();
+            }
+        }
+
+        // Everything the graph's shape and the dependency scans are a function of: the
+        // script and this header, argv (which the script may branch on), every task
+        // with the edges the script itself declared, and each group's full compile
+        // command — the flags and include paths every scan runs with.
+        u64 manifestKey(const std::vector<Task*>& tasks) const {
+            u64 hash = __fnv1a(hashFile(__BASE_FILE__));
+            hash     = __fnv1a(hashFile(__FILE__), hash);
+            for (int i = 1; i < argc_; ++i) {
+                hash = __fnv1a(std::string_view(argv_[i], strlen(argv_[i]) + 1), hash);
+            }
+
+            std::unordered_map<const Task*, u32> index;
+            for (u32 i = 0; i < tasks.size(); ++i) {
+                index[tasks[i]] = i;
+            }
+            for (const Task* task : tasks) {
+                hash = __fnv1a(std::to_string(static_cast<i32>(task->kind())) + task->groupName() + '\0', hash);
+                hash = __fnv1a(std::string_view(task->sourcePath().c_str(), task->sourcePath().native().size() + 1), hash);
+                for (const Task* parent : task->dependencies()) {
+                    hash = __fnv1a(std::to_string(index[parent]) + ',', hash);
+                }
+            }
+
+            for (const BuildGroup& group : groups_) {
+                for (const std::string& arg : group.compileConfig(false).argv) {
+                    hash = __fnv1a(std::string_view(arg.c_str(), arg.size() + 1), hash);
                 }
             }
-            return all;
+            return hash;
         }
 
+        // Adds the header-stem edges, then freezes the graph — nothing changes its shape
+        // after this. On a run where nothing the graph depends on has changed, both the
+        // scans and the edges come straight out of the manifest (see __DagManifest);
+        // otherwise only the tasks whose inputs changed are scanned again, and the
+        // edges redrawn from what's then known.
         void buildDAG() {
-            std::unordered_map<std::filesystem::path, Task*> combined;
-            for (Task* task : collectTasks()) {
-                combined[task->sourcePath().stem()] = task;
+            freezeGroups();
+            // Keyed by interned stem. A dependency's stem is looked up, never interned —
+            // a stem that no task has can't match anything anyway.
+            PathInterner&    interner = PathInterner::instance();
+            __PathMap<Task*> combined;
+            for (Task& task : task_pool_) {
+                combined[interner.stem(task.sourceId())] = &task;
+            }
+
+            std::vector<Task*> tasks;
+            tasks.reserve(task_pool_.size());
+            for (Task& task : task_pool_) {
+                tasks.push_back(&task);
+            }
+
+            // Before anything is checked or scanned: a file written from here on is
+            // newer than the scan, and gets scanned again next run.
+            i64                   scanned_at    = std::filesystem::file_time_type::clock::now().time_since_epoch().count();
+            std::filesystem::path manifest_path = build_dir_ / "dag.manifest";
+            u64                   key           = manifestKey(tasks);
+            __DagManifest         manifest;
+            bool                  cached = manifest.load(manifest_path, key, static_cast<u32>(tasks.size()));
+
+            std::vector<std::vector<std::filesystem::path>> dependencies(tasks.size());
+            usize                                           scanned = 0;
+            for (u32 i = 0; i < tasks.size(); ++i) {
+                Task& task = *tasks[i];
+                if (auto known = manifest.dependencies(i, task.isObject())) {
+                    dependencies[i] = std::move(*known);
+                } else {
+                    __TraceScope scope(trace_, "scan " + task.sourcePath().string(), "scan");
+                    dependencies[i] = task.listDependencies();
+                    ++scanned;
+                }
+
+                if (impact_ && task.isObject()) {
+                    for (const auto& dep : dependencies[i]) {
+                        u32 header = interner.intern(dep);
+                        if (header != task.sourceId()) {
+                            header_users_[header].push_back(&task);
+                        }
+                    }
+                }
+            }
+
+            if (cached && scanned == 0) {
+                std::span<const u32> edges = manifest.edges();
+                for (usize i = 0; i < edges.size(); i += 2) {
+                    tasks[edges[i]]->restoreDependency(*tasks[edges[i + 1]]);
+                }
+                RLOG(LL_DEBUG, "Task graph loaded from " + manifest_path.string());
+                graph_.freeze(tasks);
+                return;
             }
 
-            for (Task* task : collectTasks()) {
-                auto deps = task->listDependencies(build_dir_);
+            std::vector<std::pair<u32, u32>>     edges;
+            std::unordered_map<const Task*, u32> index;
+            for (u32 i = 0; i < tasks.size(); ++i) {
+                index[tasks[i]] = i;
+            }
 
-                for (const auto& dep : deps) {
-                    auto it = combined.find(dep.stem());
-                    if (it == combined.end()) {
+            for (u32 i = 0; i < tasks.size(); ++i) {
+                Task& task = *tasks[i];
+                for (const auto& dep : dependencies[i]) {
+                    std::string_view filename = __filenameOf(dep.native());
+                    u32              stem_id  = interner.find(filename.substr(0, __stemLength(filename)));
+                    Task**           match    = stem_id != PathInterner::NONE ? combined.find(stem_id) : nullptr;
+                    if (match == nullptr) {
                         continue;
                     }
 
-                    Task& other = *it->second;
-                    if (&other == task) {
+                    Task& other = **match;
+                    if (&other == &task) {
                         continue;
                     }
 
@@ -1805,18 +5643,92 @@ class Build {
                     // B.h, B's .c includes A.h) is normal and creates no real compile-order
                     // requirement, but would form a cycle here. Skip rather than let
                     // depends_on()'s cycle check FATAL the whole build over it.
-                    if (other.hasAncestor(task)) {
+                    if (other.hasAncestor(&task)) {
                         continue;
                     }
 
-                    task->depends_on(other);
+                    task.depends_on(other);
+                    edges.emplace_back(i, index[&other]);
                 }
             }
+
+            // A first build gets here before anything has created build_dir.
+            std::error_code error;
+            std::filesystem::create_directories(build_dir_, error);
+            __DagManifest::save(manifest_path, key, scanned_at, dependencies, edges);
+
+            graph_.freeze(tasks);
         }
 };
 
 inline const std::filesystem::path& BuildGroup::buildDir() const { return build_->buildDir(); }
 
+inline bool BuildGroup::forceRebuild() const { return build_->forceRebuild(); }
+
+inline bool BuildGroup::timeTrace() const { return build_->timeTrace(); }
+
+inline __CommandSignatures& BuildGroup::commandSignatures() const { return build_->commandSignatures(); }
+
+inline __RebuildExplainer& BuildGroup::explainer() const { return build_->explainer(); }
+
+inline i32 BuildGroup::jobs() const { return build_->jobs(); }
+
+inline RemoteExecutor* BuildGroup::remote() const { return build_->remote(); }
+
+inline void BuildGroup::freeze() {
+    std::filesystem::path    sym_links = build_->buildDir() / "sym_links";
+    std::vector<std::string> include_args;
+    for (const auto& include : includes_) {
+        include_args.push_back("-I" + std::visit([&](const auto& inc) { return inc.path(sym_links); }, include).string());
+    }
+
+    // GCC has no -ftime-trace — better said once here than as every compile failing.
+    if (build_->timeTrace()) {
+        CommandOutput version = Command({*compiler_, "--version"}).exec();
+        if (version.stdout_output.find("Free Software Foundation") != std::string::npos) {
+            RLOG(LL_FATAL, "--time-trace needs clang's -ftime-trace, but " + *compiler_ + " is GCC");
+        }
+    }
+
+    auto render = [&](std::vector<std::string> flags) {
+        __CompileConfig config{*compiler_, std::move(flags), {*compiler_}, build_->timeTrace()};
+        config.argv.insert(config.argv.end(), config.flags.begin(), config.flags.end());
+        config.argv.insert(config.argv.end(), include_args.begin(), include_args.end());
+        return config;
+    };
+
+    std::vector<std::string> flags = compile_flags_;
+    flags.insert(flags.end(), build_->phaseCompileFlags().begin(), build_->phaseCompileFlags().end());
+    compile_config_ = render(flags);
+    flags.push_back("-flto=thin");
+    lto_compile_config_ = render(std::move(flags));
+
+    link_config_.argv = {*compiler_};
+    link_config_.argv.insert(link_config_.argv.end(), link_flags_.begin(), link_flags_.end());
+    link_config_.argv.insert(link_config_.argv.end(), build_->phaseLinkFlags().begin(), build_->phaseLinkFlags().end());
+    link_config_.linkables.clear();
+    for (const auto& link : links_) {
+        link_config_.linkables.push_back(std::visit([](const auto& l) { return l.linkable(); }, link));
+    }
+}
+
+inline Task& BuildGroup::addTask(Output output) {
+    output.assignCommandName(*build_);
+
+    // Full path, not stem: two components can each own a same-named file
+    // (e.g. hardware_flash/flash.c and pico_flash/flash.c) without colliding.
+    u32 key = PathInterner::instance().intern(output.sourcePath());
+    if (tasks_.contains(key)) {
+        RLOG(LL_FATAL, "Task name collision: \"" + output.sourcePath().string() + "\" is already registered in this group — choose a different name");
+    }
+
+    Task& new_task = build_->newTask(std::move(output));
+    new_task.setGroup(*this);
+    new_task.setSourceId(key);
+    tasks_[key] = &new_task;
+    return new_task;
+}
+
 inline void Output::assignCommandName(Build& build) {
     std::visit(
         [&](auto& out) {
@@ -1830,80 +5742,232 @@ inline void Output::assignCommandName(Build& build) {
     );
 }
 
-inline bool Task::execute() {
-    std::filesystem::path build_dir = group_->buildDir();
-    std::filesystem::path sym_links = build_dir / "sym_links";
+inline std::optional<u64> Task::memoryHint() const { return group_->memoryHint(); }
+
+inline const std::string& Task::groupName() const { return group_->name(); }
+
+inline CommandOutput Task::execute() {
     CommandOutput result = output_.execute(
-        group_->compiler(), build_dir, group_->includePaths(sym_links), collectObjectFiles(build_dir),
-        group_->compileFlags(), group_->linkFlags(), group_->linkables()
+        group_->compileConfig(lto_), group_->linkConfig(), group_->buildDir(), collectObjectFiles(), group_->jobs(), group_->remote()
     );
 
     if (result.exit_code != 0 && !result.stderr_output.empty()) {
         RLOG(LL_ERROR, result.stderr_output);
     }
 
-    return result.exit_code == 0;
+    return result;
 }
 
-inline std::vector<std::filesystem::path> Task::listDependencies(const std::filesystem::path& build_dir) {
-    std::filesystem::path sym_links = build_dir / "sym_links";
-    return output_.listDependencies(group_->compiler(), group_->includePaths(sym_links), group_->compileFlags());
-}
+inline std::vector<std::filesystem::path> Task::listDependencies() { return output_.listDependencies(group_->compileConfig(false)); }
 
-inline std::optional<CompileCommandEntry> Task::compileCommandEntry() {
-    std::filesystem::path build_dir = group_->buildDir();
-    std::filesystem::path sym_links = build_dir / "sym_links";
-    return output_.compileCommandEntry(group_->compiler(), build_dir, group_->includePaths(sym_links), group_->compileFlags());
-}
+inline std::optional<CompileCommandEntry> Task::compileCommandEntry() { return output_.compileCommandEntry(group_->compileConfig(lto_), group_->buildDir()); }
 
 inline bool Task::needsRebuild() {
-    if (needs_rebuild_.has_value()) {
-        return *needs_rebuild_;
+    if (std::optional<bool> known = graph_->needsRebuild(id_)) {
+        return *known;
     }
 
-    std::filesystem::path build_dir = group_->buildDir();
-    bool                  stale     = output_.isStale(build_dir, collectObjectFiles(build_dir));
+    std::vector<std::filesystem::path> object_files = collectObjectFiles();
+    std::optional<std::string>         reason       = group_->forceRebuild() ? "PGO profile changed" : output_.staleReason(output_path_);
+    u32                                root         = id_;
 
-    if (!stale) {
-        for (Task* parent : parents_) {
-            if (parent->needsRebuild()) {
-                stale = true;
+    // Last compiled without --time-trace, so there's no trace to report on yet.
+    if (!reason.has_value() && isObject() && group_->timeTrace() && !std::filesystem::exists(__TimeTraceReport::tracePathFor(output_path_))) {
+        reason = "no -ftime-trace output yet";
+    }
+
+    if (!reason.has_value()) {
+        std::optional<u64> current = signature(object_files);
+        if (current.has_value() && group_->commandSignatures().changed(output_path_.string(), *current)) {
+            reason = "command line changed";
+        }
+    }
+
+    if (!reason.has_value()) {
+        for (u32 parent : graph_->parents(id_)) {
+            if (graph_->task(parent)->needsRebuild()) {
+                reason = "parent " + graph_->task(parent)->sourcePath().string() + " rebuilt";
+                root   = group_->explainer().enabled() ? group_->explainer().root(parent) : parent;
                 break;
             }
         }
     }
 
-    needs_rebuild_ = stale;
+    if (!reason.has_value()) {
+        reason = output_.staleObjectFile(output_path_, object_files);
+    }
+
+    // Recorded before the answer is published: a child reading it may look up
+    // this task's root straight away.
+    bool stale = reason.has_value();
+    if (stale) {
+        group_->explainer().record(*this, id_, std::move(*reason), root);
+    }
+    graph_->setNeedsRebuild(id_, stale);
     return stale;
 }
 
-inline void ThreadPool::workerLoop() {
-    while (true) {
-        Task* task = nullptr;
+inline std::optional<u64> Task::signature(const std::vector<std::filesystem::path>& object_files) const {
+    return output_.signature(group_->compileConfig(lto_), group_->linkConfig(), group_->buildDir(), object_files);
+}
 
-        {
-            std::unique_lock<std::mutex> lock(mutex_);
-            cv_.wait(lock, [this] { return !work_queue_.empty() || dispatch_complete_.load(); });
+inline bool __TaskPriorityLess::operator()(const Task* a, const Task* b) const { return a->priority() < b->priority(); }
 
-            if (!work_queue_.empty()) {
-                task = work_queue_.front();
-                work_queue_.pop();
+inline void TaskGraph::complete(u32 id, ThreadPool& pool) {
+    std::vector<Task*> ready;
+    for (u32 child : children(id)) {
+        if (pending_parents_[child].fetch_sub(1) == 1) {
+            if (!ready_ns_.empty()) {
+                ready_ns_[child] = __TraceRecorder::now();
             }
+            ready.push_back(tasks_[child]);
         }
+    }
+
+    if (!ready.empty()) {
+        pool.pushReady(ready);
+    }
+}
+
+inline void Task::complete(ThreadPool& pool) { graph_->complete(id_, pool); }
+
+inline void ThreadPool::workerLoop(usize index) {
+    current_pool_   = this;
+    current_worker_ = index;
+    u64 rng         = index * 0x9E3779B97F4A7C15ull + 1;
+
+    while (true) {
+        // Read before the scan, not after: a push landing mid-scan (behind where it
+        // already looked) still moves the epoch, so the wait below falls through.
+        u64   epoch = work_epoch_.load();
+        Task* task  = findWork(index, rng);
 
         if (task != nullptr) {
-            if (!build_->hasFailed()) {
-                if (auto entry = task->compileCommandEntry()) {
-                    build_->recordCompileCommand(std::move(*entry));
-                }
-                if (task->needsRebuild() && !task->execute()) {
-                    build_->reportFailure();
-                    RLOG(LL_FATAL, "Build step failed: " + task->sourcePath().string());
-                }
+            queued_.fetch_sub(1, std::memory_order_relaxed);
+            if (runner_) {
+                runner_(task);
             }
-            task->complete();
-        } else if (dispatch_complete_.load()) {
+            task->complete(*this);
+
+            if (remaining_.fetch_sub(1) == 1) {
+                // Under the mutex so the notify can't slip in between waitDrained()'s
+                // predicate check and its sleep.
+                std::lock_guard<std::mutex> lock(mutex_);
+                drained_cv_.notify_all();
+            }
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (dispatch_complete_.load()) {
             break;
         }
+
+        ++sleepers_;
+        cv_.wait(lock, [&] { return work_epoch_.load() != epoch || dispatch_complete_.load(); });
+        --sleepers_;
+    }
+
+    current_pool_ = nullptr;
+}
+
+inline void Build::runTask(Task* task) {
+    if (!observed()) {
+        progress_.started(task->id());
+        executeTask(task);
+        progress_.finished(task->id());
+        return;
+    }
+
+    i64 start   = __TraceRecorder::now();
+    i64 running = running_.fetch_add(1) + 1;
+    trace_.counter("running tasks", running);
+    trace_.counter("ready queue", thread_pool_.queued());
+    metrics_.observeRunning(running);
+
+    progress_.started(task->id());
+    std::optional<TaskOutcome> outcome = executeTask(task);
+    progress_.finished(task->id());
+
+    i64 end = __TraceRecorder::now();
+    trace_.counter("running tasks", running_.fetch_sub(1) - 1);
+    trace_.counter("ready queue", thread_pool_.queued());
+
+    f64 queue_wait = (start - graph_.readyTime(task->id())) / 1e9;
+    if (outcome.has_value() && metrics_.enabled()) {
+        metrics_.recordTask(task->groupName(), task->kind(), *outcome, (end - start) / 1e9, queue_wait);
+    }
+
+    if (trace_.enabled()) {
+        static constexpr const char* OUTCOMES[] = {"executed", "up to date", "failed", "skipped"};
+        char args[160];
+        snprintf(args, sizeof(args), "\"kind\": \"%s\", \"outcome\": \"%s\", \"queue_wait_ms\": %.3f", __taskKindName(task->kind()),
+                 outcome ? OUTCOMES[static_cast<u8>(*outcome)] : "excluded", queue_wait * 1e3);
+        trace_.slice(task->sourcePath().filename().string(), "task", start, end, args);
+    }
+}
+
+inline std::optional<TaskOutcome> Build::executeTask(Task* task) {
+    if (auto entry = task->compileCommandEntry()) {
+        recordCompileCommand(*task, std::move(*entry));
+    }
+
+    if (task->excluded()) {
+        return std::nullopt;
+    }
+
+    // Still complete()d by the worker afterwards like any other task — that's what
+    // lets the dispatch drain, and what cascades the skip to this task's children.
+    if (stopping() || task->upstreamFailed()) {
+        task->markFailed();
+        ++skipped_count_;
+        recordHistory(*task, TaskOutcome::Skipped, CommandOutput{0, "", ""});
+        return TaskOutcome::Skipped;
+    }
+
+    bool stale;
+    {
+        __TraceScope scope(trace_, "staleness check", "task");
+        stale = task->needsRebuild();
+    }
+    if (!stale) {
+        recordHistory(*task, TaskOutcome::UpToDate, CommandOutput{0, "", ""});
+        return TaskOutcome::UpToDate;
+    }
+
+    // Only charged for tasks that actually run — up-to-date ones cost nothing.
+    u64           charged = thread_pool_.acquireMemory(task->memoryEstimate());
+    CommandOutput result{0, "", ""};
+    {
+        __TraceScope scope(trace_, "execute", "task");
+        result = task->execute();
+    }
+    thread_pool_.releaseMemory(charged);
+
+    if (result.exit_code != 0) {
+        task->markFailed();
+        // A compile killed midway can leave a truncated output newer than its inputs,
+        // which the next build would otherwise take as up to date.
+        if (!task->isCommand()) {
+            std::filesystem::remove(task->outputPath());
+        }
+
+        if (__ChildProcesses::instance().cancelled()) {
+            ++skipped_count_;
+            recordHistory(*task, TaskOutcome::Skipped, CommandOutput{0, "", ""});
+            return TaskOutcome::Skipped;
+        }
+
+        recordHistory(*task, TaskOutcome::Failed, result);
+        reportFailure(*task, result.exit_code);
+        RLOG(LL_ERROR, "Build step failed: " + task->sourcePath().string());
+        return TaskOutcome::Failed;
+    }
+
+    recordHistory(*task, TaskOutcome::Executed, result);
+    if (!task->isCommand()) {
+        recordRebuilt();
+        signatures_.record(task->outputPath().string(), *task->signature());
     }
+    return TaskOutcome::Executed;
 }
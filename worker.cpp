@@ -0,0 +1,218 @@
+// Remote compile worker for build.hpp's RemoteExecutor. Takes one preprocessed TU per
+// connection, compiles it with the requested compiler and flags, and sends back the
+// exit status, diagnostics and object file. Nothing but the compiler has to exist on
+// this machine — the TU arrives already preprocessed.
+//
+//     g++ -std=c++23 -O2 -pthread worker.cpp -o worker
+//     ./worker --listen 0.0.0.0:7070 [-j N] [--compiler g++ --compiler clang++ ...]
+//     ./worker --listen unix:/tmp/build-worker.sock
+//
+// and then, on the machine running the build:
+//
+//     ./build -j 64 --remote farm1:7070,farm2:7070
+//
+// Without --listen it only listens on 127.0.0.1:7070. Only ever expose it to machines
+// you trust. --compiler restricts which compiler executables it will run; left out,
+// the usual gcc/clang driver names are allowed. Flags that would have the driver run
+// or load other code, or read or write files outside the compile's scratch directory,
+// are refused (see REJECTED_FLAG_PREFIXES) — but the compiler itself still parses
+// whatever it's sent.
+
+#include "build.hpp"
+
+static std::unordered_set<std::string> allowed_compilers;
+
+// Matched against the start of each flag. -Wl, and friends pass options straight
+// through to another tool, which can load plugins of its own.
+static constexpr std::string_view REJECTED_FLAG_PREFIXES[] = {
+    // Run or load code on this machine.
+    "-wrapper", "-fplugin", "-fpass-plugin", "-specs", "--specs", "-B", "--prefix", "-Xclang", "-Xassembler", "-Xpreprocessor",
+    "-Xlinker", "-Wa,", "-Wp,", "-Wl,",
+    // Read or write files the worker didn't create — the output path is the worker's
+    // own, and response files pull in arbitrary ones.
+    "@", "-o", "--output", "-MD", "-MMD", "-MF", "-MJ", "-save-temps", "--save-temps", "-dumpdir", "-dumpbase", "-include", "--include",
+    "-imacros", "--imacros", "-fprofile-generate", "-fprofile-instr-generate", "-fcs-profile-generate", "-fprofile-dir", "-fdump-",
+    "-fcrash-diagnostics-dir", "-ftime-trace=", "-fmodules-cache-path",
+};
+
+static bool rejectedFlag(const std::string& flag) {
+    return std::ranges::any_of(REJECTED_FLAG_PREFIXES, [&](std::string_view prefix) { return flag.starts_with(prefix); });
+}
+
+// Counts compiles in flight, so -j caps concurrent compiles however many
+// connections are open at once.
+static std::mutex              slots_mutex;
+static std::condition_variable slots_cv;
+static i32                     free_slots = 0;
+
+// Command::exec() hands its string to sh -c, and every argument here came off the
+// network — each one goes through single quotes, not onto the command line raw.
+static std::string shellQuote(const std::string& arg) {
+    std::string quoted = "'";
+    for (char c : arg) {
+        if (c == '\'') {
+            quoted += "'\\''";
+        } else {
+            quoted += c;
+        }
+    }
+    return quoted + "'";
+}
+
+static void reply(i32 fd, const CommandOutput& result, const std::string& object) {
+    char status[96];
+    snprintf(
+        status, sizeof(status), "%d %.6f %llu", result.exit_code, result.cpu_seconds, static_cast<unsigned long long>(result.peak_rss_bytes)
+    );
+
+    __sendFrame(fd, __REMOTE_PROTOCOL) && __sendFrame(fd, status) && __sendFrame(fd, result.stderr_output) && __sendFrame(fd, object);
+}
+
+// Caps for everything but the TU itself, checked before anything is allocated —
+// otherwise a handful of bad clients each announcing 1 GiB frames exhausts memory
+// long before the compile slots limit anything.
+static constexpr u32   MAX_FIELD_BYTES = 4096;
+static constexpr u32   MAX_FLAG_BYTES  = 64 * 1024;
+static constexpr usize MAX_FLAGS       = 4096;
+// A client that connects and then goes quiet gives up its thread after this long.
+// Compiling happens between the last receive and the first send, so it's not
+// counted against this.
+static constexpr i32   IO_TIMEOUT_SECONDS = 60;
+
+static void serve(i32 fd) {
+    __setSocketTimeouts(fd, IO_TIMEOUT_SECONDS);
+
+    std::string tag, compiler, extension, name, count;
+    if (!__recvFrame(fd, tag, MAX_FIELD_BYTES) || tag != __REMOTE_PROTOCOL || !__recvFrame(fd, compiler, MAX_FIELD_BYTES)
+        || !__recvFrame(fd, extension, MAX_FIELD_BYTES) || !__recvFrame(fd, name, MAX_FIELD_BYTES) || !__recvFrame(fd, count, MAX_FIELD_BYTES)) {
+        close(fd);
+        return;
+    }
+
+    std::vector<std::string> flags;
+    usize                    flag_count = 0;
+    try {
+        flag_count = std::stoull(count);
+    } catch (...) {
+        close(fd);
+        return;
+    }
+    if (flag_count > MAX_FLAGS) {
+        close(fd);
+        return;
+    }
+    for (usize i = 0; i < flag_count; ++i) {
+        if (!__recvFrame(fd, flags.emplace_back(), MAX_FLAG_BYTES)) {
+            close(fd);
+            return;
+        }
+    }
+
+    std::string source;
+    if (!__recvFrame(fd, source)) {
+        close(fd);
+        return;
+    }
+
+    // A rejected compiler, or a bad extension trying to escape the scratch dir, is
+    // answered as a failed compile — the build reports it instead of silently falling
+    // back to compiling everything locally.
+    if (!allowed_compilers.contains(compiler) || extension.find('/') != std::string::npos) {
+        reply(fd, CommandOutput{1, "", "worker: compiler \"" + compiler + "\" is not allowed on this worker\n"}, "");
+        close(fd);
+        return;
+    }
+    if (auto flag = std::ranges::find_if(flags, rejectedFlag); flag != flags.end()) {
+        reply(fd, CommandOutput{1, "", "worker: flag \"" + *flag + "\" is not allowed on this worker\n"}, "");
+        close(fd);
+        return;
+    }
+
+    std::string scratch_template = (std::filesystem::temp_directory_path() / "buildcpp_worker_XXXXXX").string();
+    if (mkdtemp(scratch_template.data()) == nullptr) {
+        reply(fd, CommandOutput{1, "", "worker: failed to create a scratch directory\n"}, "");
+        close(fd);
+        return;
+    }
+    std::filesystem::path scratch = scratch_template;
+    // Named after the original source — shows up in any diagnostic that escapes the
+    // preprocessor's own line markers.
+    std::filesystem::path input  = scratch / (std::filesystem::path(name).stem().string() + extension);
+    std::filesystem::path output = scratch / "out.o";
+    std::ofstream(input, std::ios::binary).write(source.data(), static_cast<std::streamsize>(source.size()));
+
+    Command compile({shellQuote(compiler)});
+    for (const std::string& flag : flags) {
+        compile.push_back(shellQuote(flag));
+    }
+    compile.push_back("-c");
+    compile.push_back(shellQuote(input.string()));
+    compile.push_back("-o");
+    compile.push_back(shellQuote(output.string()));
+
+    {
+        std::unique_lock<std::mutex> lock(slots_mutex);
+        slots_cv.wait(lock, [] { return free_slots > 0; });
+        --free_slots;
+    }
+    CommandOutput result = compile.exec();
+    {
+        std::lock_guard<std::mutex> lock(slots_mutex);
+        ++free_slots;
+    }
+    slots_cv.notify_one();
+
+    std::string object;
+    if (result.exit_code == 0) {
+        std::ifstream file(output, std::ios::binary);
+        object.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    reply(fd, result, object);
+    close(fd);
+    std::filesystem::remove_all(scratch);
+
+    RLOG(LL_DEBUG, "Compiled " + name + " (exit " + std::to_string(result.exit_code) + ")");
+}
+
+int main(int argc, char** argv) {
+    initLog(1 << 16);
+
+    std::string listen_on = "127.0.0.1:7070";
+    free_slots = static_cast<i32>(std::max(1u, std::thread::hardware_concurrency()));
+
+    for (int i = 1; i < argc - 1; ++i) {
+        std::string flag = argv[i];
+        if (flag == "--listen") {
+            listen_on = argv[++i];
+        } else if (flag == "-j") {
+            free_slots = std::max(1, std::atoi(argv[++i]));
+        } else if (flag == "--compiler") {
+            allowed_compilers.insert(argv[++i]);
+        }
+    }
+
+    if (allowed_compilers.empty()) {
+        allowed_compilers = {"cc", "c++", "gcc", "g++", "clang", "clang++"};
+    }
+
+    i32 listener = __openEndpoint(listen_on, true);
+    if (listener < 0) {
+        RLOG(LL_FATAL, "Failed to listen on " + listen_on + ": " + std::string(strerror(errno)));
+    }
+    RLOG(LL_INFO, "Listening on " + listen_on + " with " + std::to_string(free_slots) + " compile slots");
+
+    // A client that hangs up mid-reply must not take the whole worker down with it.
+    signal(SIGPIPE, SIG_IGN);
+
+    while (true) {
+        i32 fd = accept(listener, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno != EINTR) {
+                RLOG(LL_ERROR, "accept failed: " + std::string(strerror(errno)));
+            }
+            continue;
+        }
+        std::thread(serve, fd).detach();
+    }
+}